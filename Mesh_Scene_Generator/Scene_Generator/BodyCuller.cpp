@@ -0,0 +1,128 @@
+#include "BodyCuller.h"
+#include <algorithm>
+#include <limits>
+#include "CheckCollisions.h"
+#include "Log.h"
+
+
+BodyCuller::BodyCuller(double checkPeriod)
+{
+    CheckPeriod = checkPeriod;
+    // Same threshold as the one used when writing the output
+    FallThreshold = -7.0;
+    EscapeMargin = 1.0;
+    MaxSpeed = 20.0;
+    PenetrationThreshold = -0.1;
+    // Three consecutive checks at the default period
+    StuckDuration = 0.2;
+    LastCheckTime = -std::numeric_limits<double>::infinity();
+    CulledCount[CullReason::Fallen] = 0;
+    CulledCount[CullReason::Escaped] = 0;
+    CulledCount[CullReason::Exploded] = 0;
+    CulledCount[CullReason::Stuck] = 0;
+}
+
+void BodyCuller::OnStep(chrono::ChSystem& mphysicalSystem, Scene& scene)
+{
+    double time = mphysicalSystem.GetChTime();
+    // A restored checkpoint can bring the time back, the period then starts again from there
+    if (time < LastCheckTime)
+        LastCheckTime = time;
+    // The tolerance keeps the accumulated rounding of the step times from delaying a check by a whole step
+    if (time - LastCheckTime >= CheckPeriod * (1.0 - 1e-6))
+    {
+        LastCheckTime = time;
+        Cull(mphysicalSystem, scene);
+    }
+}
+
+int BodyCuller::Cull(chrono::ChSystem& mphysicalSystem, Scene& scene)
+{
+    auto collision_checker = chrono_types::make_shared<CheckCollisions>(PenetrationThreshold);
+    mphysicalSystem.GetContactContainer()->ReportAllContacts(collision_checker);
+
+    double time = mphysicalSystem.GetChTime();
+    std::map<chrono::ChBody*, double> penetrationStart;
+    std::vector<chrono::ChContactable*> toIgnore;
+    int removed = 0;
+
+    for (int i = scene.MovingObjects.size() - 1; i > -1; i--)
+    {
+        std::shared_ptr<chrono::ChBody> body = scene.MovingObjects[i].CollisionBody;
+        chrono::ChVector<> position = body->GetPos();
+
+        bool culled = true;
+        CullReason reason;
+        if (position[1] < FallThreshold)
+            reason = CullReason::Fallen;
+        else if (position[0] < scene.SceneBoundingBoxMin[0] - EscapeMargin || position[0] > scene.SceneBoundingBoxMax[0] + EscapeMargin
+            || position[2] < scene.SceneBoundingBoxMin[2] - EscapeMargin || position[2] > scene.SceneBoundingBoxMax[2] + EscapeMargin
+            || position[1] > scene.SceneBoundingBoxMax[1] + EscapeMargin)
+            reason = CullReason::Escaped;
+        else if (body->GetPos_dt().Length() > MaxSpeed)
+            reason = CullReason::Exploded;
+        else
+        {
+            culled = false;
+            reason = CullReason::Stuck;
+            chrono::ChContactable* contact = body->GetCollisionModel()->GetContactable();
+            auto badContact = collision_checker->contacts.find(contact);
+            if (badContact != collision_checker->contacts.end() && badContact->second)
+            {
+                auto previous = PenetrationStart.find(body.get());
+                double start = previous != PenetrationStart.end() ? previous->second : time;
+                // Only one body of an interpenetrated pair is removed, the other one is then free to move
+                if (time - start >= StuckDuration * (1.0 - 1e-6) && std::find(toIgnore.begin(), toIgnore.end(), contact) == toIgnore.end())
+                {
+                    toIgnore.push_back(collision_checker->linkedContactable[contact]);
+                    culled = true;
+                }
+                else
+                    penetrationStart[body.get()] = start;
+            }
+        }
+
+        if (culled)
+        {
+            CulledCount[reason]++;
+            Log::Out() << "Culling (" << GetReasonName(reason) << ") " << scene.MovingObjects[i].BaseObject.AssociatedFile << std::endl;
+            scene.RemoveMovingObject(mphysicalSystem, i);
+            removed++;
+        }
+    }
+
+    // Bodies which were not interpenetrated during this check start again from zero
+    PenetrationStart = penetrationStart;
+    return removed;
+}
+
+int BodyCuller::GetTotalCulled()
+{
+    int total = 0;
+    for (auto& count : CulledCount)
+        total += count.second;
+    return total;
+}
+
+void BodyCuller::PrintReport(std::ostream& outputStream)
+{
+    outputStream << "Culled bodies : " << GetTotalCulled() << std::endl;
+    for (auto& count : CulledCount)
+        outputStream << "  " << GetReasonName(count.first) << " : " << count.second << std::endl;
+}
+
+const char* BodyCuller::GetReasonName(CullReason reason)
+{
+    switch (reason)
+    {
+    case CullReason::Fallen:
+        return "fallen";
+    case CullReason::Escaped:
+        return "escaped";
+    case CullReason::Exploded:
+        return "exploded";
+    case CullReason::Stuck:
+        return "stuck";
+    }
+    return "unknown";
+}
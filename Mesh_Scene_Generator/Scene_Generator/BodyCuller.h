@@ -0,0 +1,102 @@
+#pragma once
+#include <map>
+#include <ostream>
+#include "Scene.h"
+
+/// <summary>
+/// Reasons for which a body can be removed from the simulation before its end
+/// </summary>
+enum class CullReason
+{
+	/// <summary>
+	/// The body fell through the floor
+	/// </summary>
+	Fallen,
+	/// <summary>
+	/// The body left the scene bounding box
+	/// </summary>
+	Escaped,
+	/// <summary>
+	/// The body moves too fast to be the result of a sane contact
+	/// </summary>
+	Exploded,
+	/// <summary>
+	/// The body stayed deeply interpenetrated with another one for too long
+	/// </summary>
+	Stuck
+};
+
+/// <summary>
+/// Remove, during the simulation, the bodies which will be rejected at output anyway, so that they stop generating contacts and solver work
+/// </summary>
+class BodyCuller
+{
+public:
+	/// <summary>
+	/// Build a culler
+	/// </summary>
+	/// <param name="checkPeriod">The bodies are checked once every checkPeriod seconds of simulated time</param>
+	BodyCuller(double checkPeriod = 0.1);
+	/// <summary>
+	/// To be called after each simulation step, the bodies are only checked once CheckPeriod has elapsed since the last check
+	/// </summary>
+	/// <param name="mphysicalSystem">The physical engine containing the scene</param>
+	/// <param name="scene">The scene whose moving objects are checked</param>
+	void OnStep(chrono::ChSystem& mphysicalSystem, Scene& scene);
+	/// <summary>
+	/// Check every moving object of the scene and remove the offending ones from the engine and from the scene
+	/// </summary>
+	/// <param name="mphysicalSystem">The physical engine containing the scene</param>
+	/// <param name="scene">The scene whose moving objects are checked</param>
+	/// <returns>The number of removed objects</returns>
+	int Cull(chrono::ChSystem& mphysicalSystem, Scene& scene);
+	/// <summary>
+	/// Total number of bodies removed since the culler creation
+	/// </summary>
+	int GetTotalCulled();
+	/// <summary>
+	/// Write the number of removed bodies for each reason
+	/// </summary>
+	void PrintReport(std::ostream& outputStream);
+	/// <summary>
+	/// Readable name of a cull reason
+	/// </summary>
+	static const char* GetReasonName(CullReason reason);
+
+public:
+	/// <summary>
+	/// Simulated time (s) between two checks, independent of the step size chosen by the timestep controller
+	/// </summary>
+	double CheckPeriod;
+	/// <summary>
+	/// Height (m) under which a body is considered fallen through the floor
+	/// </summary>
+	double FallThreshold;
+	/// <summary>
+	/// Distance (m) outside the scene bounding box from which a body is considered escaped
+	/// </summary>
+	double EscapeMargin;
+	/// <summary>
+	/// Speed (m/s) above which a body is considered exploded
+	/// </summary>
+	double MaxSpeed;
+	/// <summary>
+	/// Contact distance (negative, m) under which a body is considered deeply interpenetrated
+	/// </summary>
+	double PenetrationThreshold;
+	/// <summary>
+	/// Simulated time (s) a body has to stay interpenetrated, from one check to the next, before being removed
+	/// </summary>
+	double StuckDuration;
+	/// <summary>
+	/// Number of removed bodies for each reason
+	/// </summary>
+	std::map<CullReason, int> CulledCount;
+
+private:
+	double LastCheckTime;
+	/// <summary>
+	/// Time of the first check of the current streak during which each body has been found interpenetrated
+	/// </summary>
+	std::map<chrono::ChBody*, double> PenetrationStart;
+};
@@ -1,5 +1,10 @@
 #include "CheckCollisions.h"
 
+CheckCollisions::CheckCollisions(double penetrationThreshold)
+{
+    PenetrationThreshold = penetrationThreshold;
+}
+
 bool CheckCollisions::OnReportContact(const chrono::ChVector<>& pA,
     const chrono::ChVector<>& pB,
     const chrono::ChMatrix33<>& plane_coord,
@@ -14,7 +19,7 @@ bool CheckCollisions::OnReportContact(const chrono::ChVector<>& pA,
     chrono::ChVector<> v1 = pA;
     chrono::ChVector<> v2;
     chrono::ChVector<> vn = mplanecoord.Get_A_Xaxis();
-    if (distance < -0.05)
+    if (distance < PenetrationThreshold)
     {
         contacts[modA] = true;
         contacts[modB] = true;
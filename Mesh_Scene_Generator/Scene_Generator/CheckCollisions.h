@@ -12,6 +12,12 @@ using namespace chrono;
 class CheckCollisions : public ChContactContainer::ReportContactCallback
 {
 public:
+    /// <summary>
+    /// Build a contact checker
+    /// </summary>
+    /// <param name="penetrationThreshold">Contacts with a distance lower than this (negative, m) are considered bad contacts</param>
+    CheckCollisions(double penetrationThreshold = -0.05);
+
     virtual bool OnReportContact(const ChVector<>& pA,
         const ChVector<>& pB,
         const ChMatrix33<>& plane_coord,
@@ -24,5 +30,6 @@ public:
 
     std::map<chrono::ChContactable*, bool> contacts;
     std::map<chrono::ChContactable*, chrono::ChContactable*> linkedContactable;
+    double PenetrationThreshold;
 };
 
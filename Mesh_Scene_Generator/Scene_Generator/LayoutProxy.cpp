@@ -0,0 +1,336 @@
+#include "LayoutProxy.h"
+#include <chrono>
+#include <cmath>
+#include <algorithm>
+#include <iostream>
+#include "Log.h"
+
+
+namespace
+{
+    // Grids of a plane are limited to this number of cells, larger planes are kept in the fallback mesh
+    const size_t MaxCells = 1 << 22;
+
+    // Triangles lying in the same axis aligned plane, whatever their winding
+    struct PlaneCluster
+    {
+        int Axis;
+        // +1 if the boxes are placed on the positive side of the plane, else -1
+        int Side;
+        double Offset;
+        std::vector<int> Triangles;
+        // Bounds of the triangles along the two other axes
+        double MinU, MaxU, MinV, MaxV;
+        // Thickness of the boxes behind the plane
+        double Depth;
+    };
+
+    // Rectangle of filled cells of a plane grid
+    struct CellRectangle
+    {
+        int I, J, Width, Height;
+    };
+
+    bool containsPoint(double au, double av, double bu, double bv, double cu, double cv, double pu, double pv)
+    {
+        // Points on an edge are inside, so that the cells on the edges shared by two triangles are filled
+        const double epsilon = 1e-12;
+        double d1 = (bu - au) * (pv - av) - (bv - av) * (pu - au);
+        double d2 = (cu - bu) * (pv - bv) - (cv - bv) * (pu - bu);
+        double d3 = (au - cu) * (pv - cv) - (av - cv) * (pu - cu);
+        bool hasNegative = d1 < -epsilon || d2 < -epsilon || d3 < -epsilon;
+        bool hasPositive = d1 > epsilon || d2 > epsilon || d3 > epsilon;
+        return !(hasNegative && hasPositive);
+    }
+
+    // Greedy decomposition of the filled cells in rectangles, each extended along its row then over the following rows
+    std::vector<CellRectangle> mergeCells(const std::vector<char>& filled, int width, int height)
+    {
+        std::vector<CellRectangle> rectangles;
+        std::vector<char> used(filled.size(), 0);
+        for (int j = 0; j < height; j++)
+        {
+            for (int i = 0; i < width; i++)
+            {
+                size_t index = (size_t)j * width + i;
+                if (!filled[index] || used[index])
+                    continue;
+
+                int rectangleWidth = 1;
+                while (i + rectangleWidth < width && filled[index + rectangleWidth] && !used[index + rectangleWidth])
+                    rectangleWidth++;
+                int rectangleHeight = 1;
+                for (bool full = true; full && j + rectangleHeight < height; )
+                {
+                    size_t row = (size_t)(j + rectangleHeight) * width + i;
+                    for (int k = 0; k < rectangleWidth && full; k++)
+                        full = filled[row + k] && !used[row + k];
+                    if (full)
+                        rectangleHeight++;
+                }
+
+                for (int l = 0; l < rectangleHeight; l++)
+                    std::fill(used.begin() + (size_t)(j + l) * width + i, used.begin() + (size_t)(j + l) * width + i + rectangleWidth, 1);
+                rectangles.push_back({ i, j, rectangleWidth, rectangleHeight });
+            }
+        }
+        return rectangles;
+    }
+}
+
+
+void LayoutProxy::BuildCollisionModel(chrono::ChBody& body, std::shared_ptr<chrono::ChMaterialSurfaceNSC> material) const
+{
+    auto model = body.GetCollisionModel();
+    model->ClearModel();
+    for (const ProxyBox& box : Boxes)
+        model->AddBox(material, box.HalfSize[0], box.HalfSize[1], box.HalfSize[2], box.Center);
+    if (FallbackMesh)
+        model->AddTriangleMesh(material, FallbackMesh, false, false, chrono::VNULL, chrono::ChMatrix33<>(1), 0.005);
+    model->BuildModel();
+}
+
+LayoutProxyBuilder::LayoutProxyBuilder(double planeTolerance, double cellSize, double thickness, int maxBoxesPerPlane)
+{
+    PlaneTolerance = planeTolerance;
+    CellSize = cellSize;
+    Thickness = thickness;
+    MaxBoxesPerPlane = maxBoxesPerPlane;
+    MinAxisAlignment = 0.999;
+}
+
+std::shared_ptr<const LayoutProxy> LayoutProxyBuilder::Fit(chrono::geometry::ChTriangleMeshConnected& mesh)
+{
+    auto start = std::chrono::steady_clock::now();
+    auto proxy = std::make_shared<LayoutProxy>();
+    std::vector<chrono::ChVector<double>>& vertices = mesh.getCoordsVertices();
+    std::vector<chrono::ChVector<int>>& faces = mesh.getIndicesVertexes();
+
+    // Sort the axis aligned triangles by axis, the others go to the fallback mesh. Degenerate triangles are dropped.
+    // The winding is ignored : the layouts do not consistently face the inside of the rooms.
+    std::vector<char> proxied(faces.size(), 0);
+    std::vector<std::pair<double, int>> alignedTriangles[3];
+    for (size_t t = 0; t < faces.size(); t++)
+    {
+        const chrono::Vector& a = vertices[faces[t][0]];
+        const chrono::Vector& b = vertices[faces[t][1]];
+        const chrono::Vector& c = vertices[faces[t][2]];
+        chrono::Vector normal = chrono::Vcross(b - a, c - a);
+        double length = normal.Length();
+        if (length < 1e-12)
+        {
+            proxied[t] = 1;
+            continue;
+        }
+        for (int axis = 0; axis < 3; axis++)
+        {
+            if (std::abs(normal[axis]) >= MinAxisAlignment * length)
+            {
+                alignedTriangles[axis].push_back({ (a[axis] + b[axis] + c[axis]) / 3.0, (int)t });
+                break;
+            }
+        }
+    }
+
+    // Group the triangles of each axis in planes, the offsets of a plane spanning at most PlaneTolerance
+    std::vector<PlaneCluster> planes;
+    for (int axis = 0; axis < 3; axis++)
+    {
+        int u = (axis + 1) % 3;
+        int v = (axis + 2) % 3;
+        std::vector<std::pair<double, int>>& triangles = alignedTriangles[axis];
+        std::sort(triangles.begin(), triangles.end());
+        for (size_t first = 0, last = 0; first < triangles.size(); first = last)
+        {
+            PlaneCluster plane;
+            plane.Axis = axis;
+            plane.Side = 1;
+            plane.MinU = plane.MinV = HUGE_VAL;
+            plane.MaxU = plane.MaxV = -HUGE_VAL;
+            plane.Depth = Thickness;
+            double offsetSum = 0.0;
+            for (last = first; last < triangles.size() && triangles[last].first - triangles[first].first <= PlaneTolerance; last++)
+            {
+                int t = triangles[last].second;
+                plane.Triangles.push_back(t);
+                offsetSum += triangles[last].first;
+                for (int k = 0; k < 3; k++)
+                {
+                    const chrono::Vector& vertex = vertices[faces[t][k]];
+                    plane.MinU = std::min(plane.MinU, vertex[u]);
+                    plane.MaxU = std::max(plane.MaxU, vertex[u]);
+                    plane.MinV = std::min(plane.MinV, vertex[v]);
+                    plane.MaxV = std::max(plane.MaxV, vertex[v]);
+                }
+            }
+            plane.Offset = offsetSum / (last - first);
+            planes.push_back(plane);
+        }
+    }
+
+    chrono::Vector meshMin(HUGE_VAL, HUGE_VAL, HUGE_VAL);
+    chrono::Vector meshMax(-HUGE_VAL, -HUGE_VAL, -HUGE_VAL);
+    for (const chrono::Vector& vertex : vertices)
+    {
+        for (int axis = 0; axis < 3; axis++)
+        {
+            meshMin[axis] = std::min(meshMin[axis], vertex[axis]);
+            meshMax[axis] = std::max(meshMax[axis], vertex[axis]);
+        }
+    }
+
+    // The boxes go on the side of a plane away from the room interior, found from the parallel planes facing it :
+    // - across a room, the opposite surface is meters away, while behind a wall or a slab its other face is a few centimeters away,
+    //   so the box goes towards the nearest one and must not cross it
+    // - a surface of the layout outer shell has nothing behind it
+    // - a surface facing nothing on either side is taken as part of the outer shell, its boxes go away from the layout center
+    for (PlaneCluster& plane : planes)
+    {
+        double gapAbove = HUGE_VAL;
+        double gapBelow = HUGE_VAL;
+        for (const PlaneCluster& other : planes)
+        {
+            if (other.Axis != plane.Axis || &other == &plane || other.MaxU <= plane.MinU || other.MinU >= plane.MaxU || other.MaxV <= plane.MinV || other.MinV >= plane.MaxV)
+                continue;
+            if (other.Offset > plane.Offset)
+                gapAbove = std::min(gapAbove, other.Offset - plane.Offset);
+            else
+                gapBelow = std::min(gapBelow, plane.Offset - other.Offset);
+        }
+
+        double gap;
+        if (gapAbove == HUGE_VAL && gapBelow == HUGE_VAL)
+        {
+            plane.Side = plane.Offset >= 0.5 * (meshMin[plane.Axis] + meshMax[plane.Axis]) ? 1 : -1;
+            gap = HUGE_VAL;
+        }
+        else if (gapAbove == HUGE_VAL || gapBelow == HUGE_VAL)
+        {
+            plane.Side = gapAbove == HUGE_VAL ? 1 : -1;
+            gap = HUGE_VAL;
+        }
+        else
+        {
+            plane.Side = gapAbove < gapBelow ? 1 : -1;
+            gap = std::min(gapAbove, gapBelow);
+        }
+        plane.Depth = std::max(std::min(Thickness, gap), 2.0 * PlaneTolerance);
+    }
+
+    for (const PlaneCluster& plane : planes)
+    {
+        int u = (plane.Axis + 1) % 3;
+        int v = (plane.Axis + 2) % 3;
+        // The grid spans the plane bounds exactly, so that rectangular surfaces are fitted without error
+        int width = std::max(1, (int)std::lround((plane.MaxU - plane.MinU) / CellSize));
+        int height = std::max(1, (int)std::lround((plane.MaxV - plane.MinV) / CellSize));
+        if (plane.MaxU <= plane.MinU || plane.MaxV <= plane.MinV || (size_t)width * height > MaxCells)
+            continue;
+        double cellU = (plane.MaxU - plane.MinU) / width;
+        double cellV = (plane.MaxV - plane.MinV) / height;
+
+        // A cell is filled if its center lies in a triangle. Triangles too small to contain a center stay in the fallback mesh.
+        std::vector<char> filled((size_t)width * height, 0);
+        std::vector<int> rasterizedTriangles;
+        for (int t : plane.Triangles)
+        {
+            const chrono::Vector& a = vertices[faces[t][0]];
+            const chrono::Vector& b = vertices[faces[t][1]];
+            const chrono::Vector& c = vertices[faces[t][2]];
+            int minI = std::max(0, (int)std::ceil((std::min({ a[u], b[u], c[u] }) - plane.MinU) / cellU - 0.5));
+            int maxI = std::min(width - 1, (int)std::floor((std::max({ a[u], b[u], c[u] }) - plane.MinU) / cellU - 0.5));
+            int minJ = std::max(0, (int)std::ceil((std::min({ a[v], b[v], c[v] }) - plane.MinV) / cellV - 0.5));
+            int maxJ = std::min(height - 1, (int)std::floor((std::max({ a[v], b[v], c[v] }) - plane.MinV) / cellV - 0.5));
+            bool covered = false;
+            for (int j = minJ; j <= maxJ; j++)
+            {
+                for (int i = minI; i <= maxI; i++)
+                {
+                    if (containsPoint(a[u], a[v], b[u], b[v], c[u], c[v], plane.MinU + (i + 0.5) * cellU, plane.MinV + (j + 0.5) * cellV))
+                    {
+                        filled[(size_t)j * width + i] = 1;
+                        covered = true;
+                    }
+                }
+            }
+            if (covered)
+                rasterizedTriangles.push_back(t);
+        }
+
+        std::vector<CellRectangle> rectangles = mergeCells(filled, width, height);
+        if (rectangles.empty() || (int)rectangles.size() > MaxBoxesPerPlane)
+            continue;
+
+        for (const CellRectangle& rectangle : rectangles)
+        {
+            ProxyBox box;
+            box.Center[plane.Axis] = plane.Offset + 0.5 * plane.Depth * plane.Side;
+            box.HalfSize[plane.Axis] = 0.5 * plane.Depth;
+            box.Center[u] = plane.MinU + (rectangle.I + 0.5 * rectangle.Width) * cellU;
+            box.HalfSize[u] = 0.5 * rectangle.Width * cellU;
+            box.Center[v] = plane.MinV + (rectangle.J + 0.5 * rectangle.Height) * cellV;
+            box.HalfSize[v] = 0.5 * rectangle.Height * cellV;
+            proxy->Boxes.push_back(box);
+        }
+        for (int t : rasterizedTriangles)
+            proxied[t] = 1;
+    }
+
+    // The fallback mesh only holds the vertices of its triangles
+    std::vector<int> fallbackIndices(vertices.size(), -1);
+    for (size_t t = 0; t < faces.size(); t++)
+    {
+        if (proxied[t])
+        {
+            proxy->ProxiedTriangles++;
+            continue;
+        }
+        if (!proxy->FallbackMesh)
+            proxy->FallbackMesh = chrono_types::make_shared<chrono::geometry::ChTriangleMeshConnected>();
+        chrono::ChVector<int> face;
+        for (int k = 0; k < 3; k++)
+        {
+            int& index = fallbackIndices[faces[t][k]];
+            if (index < 0)
+            {
+                index = (int)proxy->FallbackMesh->getCoordsVertices().size();
+                proxy->FallbackMesh->getCoordsVertices().push_back(vertices[faces[t][k]]);
+            }
+            face[k] = index;
+        }
+        proxy->FallbackMesh->getIndicesVertexes().push_back(face);
+        proxy->FallbackTriangles++;
+    }
+
+    std::chrono::duration<double> duration = std::chrono::steady_clock::now() - start;
+    proxy->Seconds = duration.count();
+    return proxy;
+}
+
+std::shared_ptr<const LayoutProxy> LayoutProxyBuilder::GetProxy(std::string filePath, chrono::geometry::ChTriangleMeshConnected& mesh)
+{
+    {
+        std::lock_guard<std::mutex> lock(CacheMutex);
+        auto cached = Cache.find(filePath);
+        if (cached != Cache.end())
+            return cached->second;
+    }
+
+    // As for the meshes, the fitting is done outside of the lock and the first stored proxy is kept
+    std::shared_ptr<const LayoutProxy> proxy = Fit(mesh);
+    Log::Out() << "Layout proxy of " << filePath << " : " << proxy->Boxes.size() << " boxes for " << proxy->ProxiedTriangles << " triangles, "
+        << proxy->FallbackTriangles << " triangles kept as a mesh, in " << proxy->Seconds << " s" << std::endl;
+
+    std::lock_guard<std::mutex> lock(CacheMutex);
+    auto cached = Cache.find(filePath);
+    if (cached != Cache.end())
+        return cached->second;
+    Cache[filePath] = proxy;
+    return proxy;
+}
+
+void LayoutProxyBuilder::ClearCache()
+{
+    std::lock_guard<std::mutex> lock(CacheMutex);
+    Cache.clear();
+}
@@ -0,0 +1,119 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <memory>
+#include "chrono/physics/ChBody.h"
+#include "chrono/geometry/ChTriangleMeshConnected.h"
+
+/// <summary>
+/// Axis aligned box of a layout proxy
+/// </summary>
+struct ProxyBox
+{
+	/// <summary>
+	/// Center of the box, in the layout body frame
+	/// </summary>
+	chrono::Vector Center;
+	/// <summary>
+	/// Half of the box size along each axis
+	/// </summary>
+	chrono::Vector HalfSize;
+};
+
+/// <summary>
+/// Primitive collision geometry of a scene layout : its axis aligned surfaces (floor, walls, ceiling) are replaced by thin boxes placed
+/// behind them, and only the remaining irregular triangles are kept as a mesh. Objects near the walls then collide with boxes instead of
+/// running the mesh against mesh narrowphase on the whole layout.
+/// </summary>
+struct LayoutProxy
+{
+	/// <summary>
+	/// Boxes fitted on the axis aligned surfaces
+	/// </summary>
+	std::vector<ProxyBox> Boxes;
+	/// <summary>
+	/// Triangles which are not covered by a box, nullptr if every triangle is
+	/// </summary>
+	std::shared_ptr<chrono::geometry::ChTriangleMeshConnected> FallbackMesh;
+	/// <summary>
+	/// Number of triangles replaced by the boxes
+	/// </summary>
+	int ProxiedTriangles = 0;
+	/// <summary>
+	/// Number of triangles of the fallback mesh
+	/// </summary>
+	int FallbackTriangles = 0;
+	/// <summary>
+	/// Wall time of the fitting (s)
+	/// </summary>
+	double Seconds = 0.0;
+
+	/// <summary>
+	/// Replace the collision model of the layout body by the proxy
+	/// </summary>
+	/// <param name="body">Body of the layout, whose frame is the one of the fitted mesh</param>
+	/// <param name="material">Material of the layout</param>
+	void BuildCollisionModel(chrono::ChBody& body, std::shared_ptr<chrono::ChMaterialSurfaceNSC> material) const;
+};
+
+/// <summary>
+/// Fit the layouts with primitives (see LayoutProxy), and cache the result by layout file.
+/// Chrono's Bullet collision system has no heightfield shape, so the floor is fitted with boxes like the walls.
+/// </summary>
+class LayoutProxyBuilder
+{
+public:
+	/// <summary>
+	/// Build a proxy builder
+	/// </summary>
+	/// <param name="planeTolerance">Distance (m) under which two parallel triangles are considered to lie in the same plane</param>
+	/// <param name="cellSize">Resolution (m) of the grid on which the surfaces are rasterized before being merged into boxes</param>
+	/// <param name="thickness">Thickness (m) of the boxes behind the surfaces, reduced when another parallel surface is closer behind them</param>
+	/// <param name="maxBoxesPerPlane">A plane needing more boxes is too irregular, and is kept in the fallback mesh</param>
+	LayoutProxyBuilder(double planeTolerance = 0.01, double cellSize = 0.05, double thickness = 0.05, int maxBoxesPerPlane = 64);
+	/// <summary>
+	/// Fit a layout mesh. The side of a surface the boxes go to is deduced from the parallel surfaces facing it, not from the triangles winding :
+	/// towards the nearest one (the other face of a wall or slab, which the box must not cross), else towards the side where there is none
+	/// (the outer shell of the layout), else away from the layout center.
+	/// </summary>
+	/// <param name="mesh">The layout mesh, in the layout body frame</param>
+	std::shared_ptr<const LayoutProxy> Fit(chrono::geometry::ChTriangleMeshConnected& mesh);
+	/// <summary>
+	/// Fit a layout mesh, from the cache if this layout file was already fitted
+	/// </summary>
+	/// <param name="filePath">File of the layout, used as the cache key</param>
+	/// <param name="mesh">The mesh of this file, in the layout body frame</param>
+	std::shared_ptr<const LayoutProxy> GetProxy(std::string filePath, chrono::geometry::ChTriangleMeshConnected& mesh);
+	/// <summary>
+	/// Empty the cache
+	/// </summary>
+	void ClearCache();
+
+public:
+	/// <summary>
+	/// Distance (m) under which two parallel triangles are considered to lie in the same plane
+	/// </summary>
+	double PlaneTolerance;
+	/// <summary>
+	/// Resolution (m) of the grid on which the surfaces are rasterized. The outline of a non rectangular surface is approximated by half a cell.
+	/// </summary>
+	double CellSize;
+	/// <summary>
+	/// Thickness (m) of the boxes behind the surfaces
+	/// </summary>
+	double Thickness;
+	/// <summary>
+	/// A plane needing more boxes is kept in the fallback mesh
+	/// </summary>
+	int MaxBoxesPerPlane;
+	/// <summary>
+	/// Minimum cosine between a triangle normal and an axis for the triangle to be considered axis aligned
+	/// </summary>
+	double MinAxisAlignment;
+
+private:
+	std::map<std::string, std::shared_ptr<const LayoutProxy>> Cache;
+	std::mutex CacheMutex;
+};
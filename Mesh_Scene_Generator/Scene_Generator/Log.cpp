@@ -0,0 +1,30 @@
+#include "Log.h"
+#include <iostream>
+#include <streambuf>
+
+
+namespace
+{
+    class NullBuffer : public std::streambuf
+    {
+    protected:
+        int overflow(int character) override
+        {
+            return traits_type::not_eof(character);
+        }
+    };
+
+    NullBuffer DiscardedOutput;
+}
+
+
+bool Log::Enabled = true;
+
+std::ostream& Log::Out()
+{
+    if (Enabled)
+        return std::cout;
+    // One stream per thread, as the formatting state of a stream is not thread safe
+    thread_local std::ostream nullStream(&DiscardedOutput);
+    return nullStream;
+}
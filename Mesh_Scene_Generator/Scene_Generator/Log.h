@@ -0,0 +1,21 @@
+#pragma once
+#include <ostream>
+
+/// <summary>
+/// Destination of the progress messages of the generation pipeline, which can be silenced when the generator is embedded in another process
+/// </summary>
+class Log
+{
+public:
+	/// <summary>
+	/// The standard output if Enabled, else a stream discarding everything
+	/// </summary>
+	static std::ostream& Out();
+
+public:
+	/// <summary>
+	/// If false, the pipeline messages are discarded. True by default, the executable prints its progress.
+	/// To be set before the generation starts, it is read by every thread.
+	/// </summary>
+	static bool Enabled;
+};
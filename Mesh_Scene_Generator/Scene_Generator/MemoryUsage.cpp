@@ -0,0 +1,114 @@
+#include "MemoryUsage.h"
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#include <atomic>
+#else
+#include <fstream>
+#include <string>
+#endif
+
+
+#ifdef _WIN32
+
+namespace
+{
+    // PeakWorkingSetSize covers the whole process, the peak since the last reset is sampled instead
+    std::atomic<size_t> SampledPeak(0);
+    std::atomic<bool> PeakReset(false);
+}
+
+size_t MemoryUsage::GetResident()
+{
+    PROCESS_MEMORY_COUNTERS counters;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+        return 0;
+    return counters.WorkingSetSize;
+}
+
+size_t MemoryUsage::GetPeakResident()
+{
+    if (PeakReset)
+    {
+        Sample();
+        return SampledPeak;
+    }
+    PROCESS_MEMORY_COUNTERS counters;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+        return 0;
+    return counters.PeakWorkingSetSize;
+}
+
+bool MemoryUsage::ResetPeak()
+{
+    SampledPeak = GetResident();
+    PeakReset = true;
+    return true;
+}
+
+void MemoryUsage::Sample()
+{
+    if (!PeakReset)
+        return;
+    size_t resident = GetResident();
+    size_t peak = SampledPeak;
+    while (resident > peak && !SampledPeak.compare_exchange_weak(peak, resident))
+    {
+    }
+}
+
+bool MemoryUsage::PeakIsSampled()
+{
+    return true;
+}
+
+#else
+
+namespace
+{
+    // Read a "Name: value kB" line of /proc/self/status
+    size_t ReadStatusValue(const std::string& name)
+    {
+        std::ifstream inputStream("/proc/self/status");
+        std::string key;
+        size_t value;
+        while (inputStream >> key)
+        {
+            if (key == name && inputStream >> value)
+                return value * 1024;
+            inputStream.ignore(256, '\n');
+        }
+        return 0;
+    }
+}
+
+size_t MemoryUsage::GetResident()
+{
+    return ReadStatusValue("VmRSS:");
+}
+
+size_t MemoryUsage::GetPeakResident()
+{
+    return ReadStatusValue("VmHWM:");
+}
+
+bool MemoryUsage::ResetPeak()
+{
+    // Writing 5 to clear_refs resets VmHWM (Linux 4.0 and later)
+    std::ofstream outputStream("/proc/self/clear_refs");
+    outputStream << "5";
+    outputStream.flush();
+    return outputStream.good();
+}
+
+void MemoryUsage::Sample()
+{
+}
+
+bool MemoryUsage::PeakIsSampled()
+{
+    return false;
+}
+
+#endif
@@ -0,0 +1,32 @@
+#pragma once
+#include <cstddef>
+
+/// <summary>
+/// Resident memory of the current process, as reported by the operating system
+/// </summary>
+class MemoryUsage
+{
+public:
+	/// <summary>
+	/// Current resident memory (bytes), 0 if unknown
+	/// </summary>
+	static size_t GetResident();
+	/// <summary>
+	/// Highest resident memory (bytes) since the process start or the last successful ResetPeak, 0 if unknown
+	/// </summary>
+	static size_t GetPeakResident();
+	/// <summary>
+	/// Restart the peak measure from the current resident memory.
+	/// Windows cannot reset its own peak, the peak is then the highest of the values recorded by Sample.
+	/// </summary>
+	/// <returns>False if the system does not allow it (then the peak stays the one of the whole process)</returns>
+	static bool ResetPeak();
+	/// <summary>
+	/// Record the current resident memory in the peak, where the peak is sampled (see PeakIsSampled). Does nothing elsewhere.
+	/// </summary>
+	static void Sample();
+	/// <summary>
+	/// True if the peak since ResetPeak only covers the values recorded by Sample, so that the allocations freed between two samples are missed
+	/// </summary>
+	static bool PeakIsSampled();
+};
@@ -0,0 +1,282 @@
+#include "MeshWelder.h"
+#include <thread>
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cmath>
+#include <iostream>
+#include "ParallelFor.h"
+#include "SpatialHash.h"
+#include "Log.h"
+
+
+namespace
+{
+    // Vertices are searched by chunks, each chunk writing its own list of candidates
+    const size_t ChunkSize = 1 << 14;
+
+    // Keep the entries of a per vertex attribute whose index is kept
+    template <typename T>
+    void CompactPerVertex(std::vector<T>& values, const std::vector<int>& keptVertices)
+    {
+        std::vector<T> compacted(keptVertices.size());
+        for (size_t i = 0; i < keptVertices.size(); i++)
+            compacted[i] = values[keptVertices[i]];
+        values.swap(compacted);
+    }
+
+    void CompactFaces(std::vector<chrono::ChVector<int>>& indices, const std::vector<char>& keptFaces)
+    {
+        size_t kept = 0;
+        for (size_t i = 0; i < indices.size(); i++)
+        {
+            if (keptFaces[i])
+                indices[kept++] = indices[i];
+        }
+        indices.resize(kept);
+    }
+}
+
+
+MeshWelder::MeshWelder(double tolerance, int numberOfThreads)
+{
+    Tolerance = tolerance;
+    NumberOfThreads = numberOfThreads > 0 ? numberOfThreads : std::max(1, (int)std::thread::hardware_concurrency());
+    MaxCachedVertices = 5000000;
+    CachedVertices = 0;
+}
+
+WeldStatistics MeshWelder::Weld(chrono::geometry::ChTriangleMeshConnected& mesh, int numberOfThreads)
+{
+    int threads = numberOfThreads > 0 ? numberOfThreads : NumberOfThreads;
+    auto start = std::chrono::steady_clock::now();
+    std::vector<chrono::Vector>& vertices = mesh.getCoordsVertices();
+    std::vector<chrono::ChVector<int>>& faces = mesh.getIndicesVertexes();
+    size_t numberOfVertices = vertices.size();
+
+    WeldStatistics statistics;
+    statistics.Vertices = (int)numberOfVertices;
+    statistics.MergedVertices = 0;
+    statistics.RemovedFaces = 0;
+    statistics.Seconds = 0.0;
+    if (numberOfVertices == 0 || Tolerance <= 0.0)
+        return statistics;
+
+    // Grid of cells twice as large as the tolerance, so that along each axis the duplicates of a vertex are in its cell
+    // or in the neighbouring cell on the side of the half where the vertex lies : only 8 cells are searched
+    double inverseCellSize = 0.5 / Tolerance;
+    std::vector<char> upperHalves(numberOfVertices);
+    std::vector<int64_t> cells(3 * numberOfVertices);
+    std::vector<std::pair<uint64_t, uint32_t>> sortedVertices(numberOfVertices);
+    size_t numberOfChunks = (numberOfVertices + ChunkSize - 1) / ChunkSize;
+    ParallelFor(numberOfChunks, threads, [&](size_t chunk)
+    {
+        size_t end = std::min(numberOfVertices, (chunk + 1) * ChunkSize);
+        for (size_t i = chunk * ChunkSize; i < end; i++)
+        {
+            upperHalves[i] = 0;
+            for (int axis = 0; axis < 3; axis++)
+            {
+                double coordinate = vertices[i][axis] * inverseCellSize;
+                cells[3 * i + axis] = (int64_t)std::floor(coordinate);
+                if (coordinate - cells[3 * i + axis] >= 0.5)
+                    upperHalves[i] |= 1 << axis;
+            }
+            sortedVertices[i] = std::make_pair(GetCellKey(cells[3 * i], cells[3 * i + 1], cells[3 * i + 2]), (uint32_t)i);
+        }
+    });
+
+    // Vertices of a cell are contiguous, by increasing index
+    std::sort(sortedVertices.begin(), sortedVertices.end());
+    size_t numberOfCells = 1;
+    for (size_t i = 1; i < numberOfVertices; i++)
+        numberOfCells += sortedVertices[i].first != sortedVertices[i - 1].first;
+    // Each cell is mapped to its first entry in the sorted vertex list
+    CellMap table(numberOfCells);
+    for (size_t i = 0; i < numberOfVertices; i++)
+    {
+        bool inserted;
+        if (i == 0 || sortedVertices[i].first != sortedVertices[i - 1].first)
+            table.Insert(sortedVertices[i].first, (uint32_t)i, inserted);
+    }
+
+    // For each vertex, the lowest index of the earlier vertices within the tolerance which are kept.
+    // Whether an earlier vertex is kept depends on the previous vertices, so the search (the costly part) is done in parallel
+    // and gives every earlier vertex within the tolerance, while the choice is done serially in the index order.
+    double squaredTolerance = Tolerance * Tolerance;
+    std::vector<std::vector<std::pair<uint32_t, uint32_t>>> candidates(numberOfChunks);
+    ParallelFor(numberOfChunks, threads, [&](size_t chunk)
+    {
+        std::vector<std::pair<uint32_t, uint32_t>>& chunkCandidates = candidates[chunk];
+        size_t end = std::min(numberOfVertices, (chunk + 1) * ChunkSize);
+        for (size_t i = chunk * ChunkSize; i < end; i++)
+        {
+            for (int neighbour = 0; neighbour < 8; neighbour++)
+            {
+                int64_t offsets[3];
+                for (int axis = 0; axis < 3; axis++)
+                    offsets[axis] = (neighbour & (1 << axis)) ? ((upperHalves[i] & (1 << axis)) ? 1 : -1) : 0;
+
+                uint64_t key = GetCellKey(cells[3 * i] + offsets[0], cells[3 * i + 1] + offsets[1], cells[3 * i + 2] + offsets[2]);
+                int64_t entry = table.Find(key);
+                if (entry < 0)
+                    continue;
+                for (; (size_t)entry < numberOfVertices && sortedVertices[entry].first == key && sortedVertices[entry].second < i; entry++)
+                {
+                    uint32_t j = sortedVertices[entry].second;
+                    if ((vertices[i] - vertices[j]).Length2() < squaredTolerance)
+                        chunkCandidates.push_back(std::make_pair((uint32_t)i, j));
+                }
+            }
+        }
+    });
+
+    std::vector<int> newIndices(numberOfVertices);
+    std::vector<int> keptVertices;
+    keptVertices.reserve(numberOfVertices);
+    std::vector<char> isKept(numberOfVertices, 0);
+    for (size_t chunk = 0; chunk < numberOfChunks; chunk++)
+    {
+        std::vector<std::pair<uint32_t, uint32_t>>& chunkCandidates = candidates[chunk];
+        size_t candidate = 0;
+        size_t end = std::min(numberOfVertices, (chunk + 1) * ChunkSize);
+        for (size_t i = chunk * ChunkSize; i < end; i++)
+        {
+            uint32_t target = (uint32_t)i;
+            for (; candidate < chunkCandidates.size() && chunkCandidates[candidate].first == i; candidate++)
+            {
+                uint32_t j = chunkCandidates[candidate].second;
+                if (isKept[j] && j < target)
+                    target = j;
+            }
+
+            if (target == i)
+            {
+                isKept[i] = 1;
+                newIndices[i] = (int)keptVertices.size();
+                keptVertices.push_back((int)i);
+            }
+            else
+                newIndices[i] = newIndices[target];
+        }
+        std::vector<std::pair<uint32_t, uint32_t>>().swap(chunkCandidates);
+    }
+    statistics.MergedVertices = (int)(numberOfVertices - keptVertices.size());
+
+    if (statistics.MergedVertices > 0)
+    {
+        // Attributes without their own indices follow the vertices
+        std::vector<chrono::Vector>& normals = mesh.getCoordsNormals();
+        std::vector<chrono::Vector>& uvs = mesh.getCoordsUV();
+        std::vector<chrono::ChVector<float>>& colors = mesh.getCoordsColors();
+        if (mesh.getIndicesNormals().empty() && normals.size() == numberOfVertices)
+            CompactPerVertex(normals, keptVertices);
+        if (mesh.getIndicesUV().empty() && uvs.size() == numberOfVertices)
+            CompactPerVertex(uvs, keptVertices);
+        if (mesh.getIndicesColors().empty() && colors.size() == numberOfVertices)
+            CompactPerVertex(colors, keptVertices);
+        CompactPerVertex(vertices, keptVertices);
+
+        std::vector<char> keptFaces(faces.size());
+        for (size_t f = 0; f < faces.size(); f++)
+        {
+            for (int corner = 0; corner < 3; corner++)
+                faces[f][corner] = newIndices[faces[f][corner]];
+            keptFaces[f] = faces[f][0] != faces[f][1] && faces[f][1] != faces[f][2] && faces[f][0] != faces[f][2];
+        }
+
+        size_t numberOfFaces = faces.size();
+        CompactFaces(faces, keptFaces);
+        statistics.RemovedFaces = (int)(numberOfFaces - faces.size());
+        // Attributes with their own indices keep them, only the collapsed faces are removed
+        if (statistics.RemovedFaces > 0)
+        {
+            if (mesh.getIndicesNormals().size() == numberOfFaces)
+                CompactFaces(mesh.getIndicesNormals(), keptFaces);
+            if (mesh.getIndicesUV().size() == numberOfFaces)
+                CompactFaces(mesh.getIndicesUV(), keptFaces);
+            if (mesh.getIndicesColors().size() == numberOfFaces)
+                CompactFaces(mesh.getIndicesColors(), keptFaces);
+        }
+    }
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    statistics.Seconds = elapsed.count();
+    return statistics;
+}
+
+std::shared_ptr<chrono::geometry::ChTriangleMeshConnected> MeshWelder::LoadMesh(std::string filePath, int numberOfThreads)
+{
+    return chrono_types::make_shared<chrono::geometry::ChTriangleMeshConnected>(*GetSharedMesh(filePath, numberOfThreads));
+}
+
+std::shared_ptr<chrono::geometry::ChTriangleMeshConnected> MeshWelder::GetSharedMesh(std::string filePath, int numberOfThreads)
+{
+    {
+        std::lock_guard<std::mutex> lock(CacheMutex);
+        auto cached = Cache.find(filePath);
+        if (cached != Cache.end())
+            return cached->second;
+    }
+
+    // Loading and welding are done outside of the lock, so that several meshes can be prepared at the same time
+    auto mesh = chrono_types::make_shared<chrono::geometry::ChTriangleMeshConnected>();
+    if (!mesh->LoadWavefrontMesh(filePath))
+        return mesh;
+    WeldStatistics statistics = Weld(*mesh, numberOfThreads);
+    Log::Out() << "Welded " << filePath << " : " << statistics.MergedVertices << " of " << statistics.Vertices << " vertices merged, "
+        << statistics.RemovedFaces << " faces removed" << std::endl;
+
+    // Another thread may have loaded the same mesh meanwhile, its version is kept so that the mesh is only shared once
+    std::lock_guard<std::mutex> lock(CacheMutex);
+    auto cached = Cache.find(filePath);
+    if (cached != Cache.end())
+        return cached->second;
+    // Meshes still used by the scenes stay alive when the cache is emptied
+    if (CachedVertices + mesh->getCoordsVertices().size() > MaxCachedVertices)
+    {
+        Cache.clear();
+        CachedVertices = 0;
+    }
+    Cache[filePath] = mesh;
+    CachedVertices += mesh->getCoordsVertices().size();
+    return mesh;
+}
+
+void MeshWelder::Benchmark(std::string filePath, std::ostream& outputStream)
+{
+    chrono::geometry::ChTriangleMeshConnected repaired;
+    repaired.LoadWavefrontMesh(filePath);
+    chrono::geometry::ChTriangleMeshConnected welded(repaired);
+    size_t numberOfVertices = repaired.getCoordsVertices().size();
+
+    // RepairDuplicateVertexes compares the squared distances to its tolerance
+    double repairTolerance = Tolerance * Tolerance;
+    auto start = std::chrono::steady_clock::now();
+    int repairedVertices = repaired.RepairDuplicateVertexes(repairTolerance);
+    std::chrono::duration<double> repairTime = std::chrono::steady_clock::now() - start;
+
+    WeldStatistics statistics = Weld(welded);
+
+    outputStream << filePath << " : " << numberOfVertices << " vertices" << std::endl;
+    outputStream << "  RepairDuplicateVertexes(" << repairTolerance << ") : " << repairedVertices << " merged in " << repairTime.count() << " s" << std::endl;
+    outputStream << "  Weld(" << Tolerance << ", " << NumberOfThreads << " threads) : " << statistics.MergedVertices << " merged, "
+        << statistics.RemovedFaces << " faces removed in " << statistics.Seconds << " s" << std::endl;
+}
+
+void MeshWelder::ClearCache()
+{
+    std::lock_guard<std::mutex> lock(CacheMutex);
+    Cache.clear();
+    CachedVertices = 0;
+}
+
+void MeshWelder::TrimCache(size_t maxVertices)
+{
+    std::lock_guard<std::mutex> lock(CacheMutex);
+    if (CachedVertices > maxVertices)
+    {
+        Cache.clear();
+        CachedVertices = 0;
+    }
+}
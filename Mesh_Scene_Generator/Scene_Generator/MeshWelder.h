@@ -0,0 +1,102 @@
+#pragma once
+#include <string>
+#include <map>
+#include <mutex>
+#include <memory>
+#include <ostream>
+#include "chrono/geometry/ChTriangleMeshConnected.h"
+
+/// <summary>
+/// Result of a welding
+/// </summary>
+struct WeldStatistics
+{
+	/// <summary>
+	/// Number of vertices before welding
+	/// </summary>
+	int Vertices;
+	/// <summary>
+	/// Number of vertices merged into another one
+	/// </summary>
+	int MergedVertices;
+	/// <summary>
+	/// Number of faces removed because two of their vertices were merged
+	/// </summary>
+	int RemovedFaces;
+	/// <summary>
+	/// Wall time of the welding (s)
+	/// </summary>
+	double Seconds;
+};
+
+/// <summary>
+/// Merge the duplicated vertices of meshes using a spatial hash grid, instead of the pairwise comparisons of RepairDuplicateVertexes.
+/// Meshes are welded once in model space and kept in a cache, so that every instance of an object reuses the same welded mesh.
+/// </summary>
+class MeshWelder
+{
+public:
+	/// <summary>
+	/// Build a welder
+	/// </summary>
+	/// <param name="tolerance">
+	/// Distance (in model units) under which two vertices are merged. The default, sqrt(1e-3), is the distance of the former RepairDuplicateVertexes(1e-3),
+	/// which compared squared distances. That one was applied to the scaled meshes, so the merge distance of an object is now tolerance * scale in the scene.
+	/// </param>
+	/// <param name="numberOfThreads">Number of threads used to search the duplicates, every available core if 0</param>
+	MeshWelder(double tolerance = 3.1622776601683794e-2, int numberOfThreads = 0);
+	/// <summary>
+	/// Merge the vertices closer than Tolerance. Each vertex is merged into the first kept vertex within the tolerance, as RepairDuplicateVertexes does.
+	/// Face indices are remapped, per vertex normals, UVs and colors are compacted with the vertices, and the faces collapsed by the welding are removed.
+	/// </summary>
+	/// <param name="mesh">The mesh to weld</param>
+	/// <param name="numberOfThreads">Threads used for this welding, NumberOfThreads if 0. To be lowered when called from a thread pool.</param>
+	WeldStatistics Weld(chrono::geometry::ChTriangleMeshConnected& mesh, int numberOfThreads = 0);
+	/// <summary>
+	/// Load a mesh file welded in model space, from the cache if it was already loaded
+	/// </summary>
+	/// <param name="filePath">Wavefront file of the mesh</param>
+	/// <param name="numberOfThreads">Threads welding the mesh if it is not cached yet, NumberOfThreads if 0</param>
+	/// <returns>A copy of the welded mesh, which can be freely transformed</returns>
+	std::shared_ptr<chrono::geometry::ChTriangleMeshConnected> LoadMesh(std::string filePath, int numberOfThreads = 0);
+	/// <summary>
+	/// Load a mesh file welded in model space, from the cache if it was already loaded
+	/// </summary>
+	/// <param name="filePath">Wavefront file of the mesh</param>
+	/// <param name="numberOfThreads">Threads welding the mesh if it is not cached yet, NumberOfThreads if 0</param>
+	/// <returns>The cached mesh itself, shared with every other user, which must not be modified</returns>
+	std::shared_ptr<chrono::geometry::ChTriangleMeshConnected> GetSharedMesh(std::string filePath, int numberOfThreads = 0);
+	/// <summary>
+	/// Compare the welding to RepairDuplicateVertexes on a mesh file, with the same merge distance, and write the timings and vertex counts
+	/// </summary>
+	/// <param name="filePath">Wavefront file of the mesh</param>
+	void Benchmark(std::string filePath, std::ostream& outputStream);
+	/// <summary>
+	/// Empty the cache
+	/// </summary>
+	void ClearCache();
+	/// <summary>
+	/// Empty the cache if it holds more than maxVertices vertices
+	/// </summary>
+	void TrimCache(size_t maxVertices);
+
+public:
+	/// <summary>
+	/// Distance (in model units) under which two vertices are merged
+	/// </summary>
+	double Tolerance;
+	/// <summary>
+	/// Number of threads used to search the duplicates
+	/// </summary>
+	int NumberOfThreads;
+	/// <summary>
+	/// The cache is emptied when the vertices it holds exceed this number.
+	/// Each instance gets its own copy on top of the cached mesh, so the cache is pure overhead past the meshes reused between scenes.
+	/// </summary>
+	size_t MaxCachedVertices;
+
+private:
+	std::map<std::string, std::shared_ptr<chrono::geometry::ChTriangleMeshConnected>> Cache;
+	size_t CachedVertices;
+	std::mutex CacheMutex;
+};
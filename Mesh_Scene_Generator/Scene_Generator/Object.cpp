@@ -35,23 +35,21 @@ double Object::ComputeWantedScale(std::default_random_engine randomEngine, std::
 	double wantedVolume = GenerateRandomVolume(randomEngine);
 	double currentVolume = ComputeMeshVolume(objectMesh);
 
-	std::cout << wantedVolume << " " << currentVolume << std::endl;
-
 	return cbrt(wantedVolume / currentVolume);
 }
 
 void Object::ComputeMeshBounds(std::shared_ptr<chrono::geometry::ChTriangleMeshConnected> mesh, double& xmin, double& xmax, double& ymin, double& ymax, double& zmin, double& zmax)
 {
-	std::vector<chrono::ChVector<double>> vertices = mesh->getCoordsVertices();
+	std::vector<chrono::ChVector<double>>& vertices = mesh->getCoordsVertices();
 
 	if (vertices.size() > 0)
 	{
 		xmin = vertices[0][0];
 		xmax = vertices[0][0];
-		ymin = vertices[1][0];
-		ymax = vertices[1][0];
-		zmin = vertices[2][0];
-		zmax = vertices[2][0];
+		ymin = vertices[0][1];
+		ymax = vertices[0][1];
+		zmin = vertices[0][2];
+		zmax = vertices[0][2];
 
 
 		for (int i = 1; i < vertices.size(); i++)
@@ -77,7 +75,6 @@ double Object::ComputeMeshVolume(std::shared_ptr<chrono::geometry::ChTriangleMes
 {
 	double xmin, xmax, ymin, ymax, zmin, zmax;
 	ComputeMeshBounds(mesh, xmin, xmax, ymin, ymax, zmin, zmax);
-	std::cout << " " << xmin << " " << xmax << " " << ymin << " " << ymax << " " << zmin << " " << zmax << std::endl;
 	double volume =  (xmax - xmin) * (ymax - ymin) * (zmax - zmin);
 	return volume;
 }
\ No newline at end of file
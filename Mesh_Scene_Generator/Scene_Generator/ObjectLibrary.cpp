@@ -2,6 +2,7 @@
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include "Log.h"
 
 
 ObjectLibrary::ObjectLibrary(std::string libraryRootDirectory, std::string descriptionFilePath, std::string largeObjectProbabilityFile, std::string smallObjectProbabilityFile)
@@ -20,6 +21,14 @@ ObjectLibrary::ObjectLibrary(std::string libraryRootDirectory, std::string descr
 			SmallObjects[object.Name].push_back(object);
 	}
 
+	for (auto* objectMap : { &LargeObjects, &SmallObjects })
+		for (auto& category : *objectMap)
+			for (auto& object : category.second)
+				Labels[object.Wnids] = 0;
+	int label = 1;
+	for (auto& wnidsLabel : Labels)
+		wnidsLabel.second = label++;
+
 	if (largeObjectProbabilityFile != "")
 		LargeObjectProbability = ReadProbabilityVector(largeObjectProbabilityFile);
 	if (smallObjectProbabilityFile != "")
@@ -78,17 +87,43 @@ Object ObjectLibrary::GiveRandomObject(std::default_random_engine &randomEngine,
 	}
 }
 
-Object ObjectLibrary::GetRandomObjectFromLibrary(std::default_random_engine& randomEngine, std::map<std::string, std::vector<Object>> objectMap, 
-	std::vector<std::tuple<int, std::string>> probabilities)
+Object ObjectLibrary::GetRandomObjectFromLibrary(std::default_random_engine& randomEngine, std::map<std::string, std::vector<Object>>& objectMap, 
+	std::vector<std::tuple<int, std::string>>& probabilities)
 {
 	std::string category = GetRandomCategory(probabilities, randomEngine);
 	std::uniform_int_distribution<int> uniformDistribution(0, objectMap[category].size() - 1);
 	int objectIndex = uniformDistribution(randomEngine);
-	std::cout << category << " " << objectIndex << " " << objectMap[category][objectIndex].AssociatedFile << std::endl;
+	DrawnCategories.insert(category);
+	DrawnFiles.insert(objectMap[category][objectIndex].AssociatedFile);
+	Log::Out() << category << " " << objectIndex << " " << objectMap[category][objectIndex].AssociatedFile << std::endl;
 	return objectMap[category][objectIndex];
 }
 
-std::string ObjectLibrary::GetRandomCategory(std::vector<std::tuple<int, std::string>> probabilities, std::default_random_engine& randomEngine)
+void ObjectLibrary::ClearDrawHistory()
+{
+	DrawnCategories.clear();
+	DrawnFiles.clear();
+}
+
+int ObjectLibrary::GetLabel(const std::string& wnids) const
+{
+	auto label = Labels.find(wnids);
+	if (label == Labels.end())
+	{
+		Log::Out() << "Unknown wnids " << wnids << ", labelled -1" << std::endl;
+		return -1;
+	}
+	return label->second;
+}
+
+void ObjectLibrary::WriteLabels(std::ostream& outputStream) const
+{
+	outputStream << "0 layout" << std::endl;
+	for (auto& label : Labels)
+		outputStream << label.second << " " << label.first << std::endl;
+}
+
+std::string ObjectLibrary::GetRandomCategory(std::vector<std::tuple<int, std::string>>& probabilities, std::default_random_engine& randomEngine)
 {
 	if (probabilities.size() > 1)
 	{
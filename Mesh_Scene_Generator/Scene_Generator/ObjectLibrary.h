@@ -1,6 +1,8 @@
 #pragma once
 #include <vector>
 #include <map>
+#include <set>
+#include <ostream>
 #include "Object.h"
 
 
@@ -33,11 +35,24 @@ public:
 	/// <param name="probabilities">The probability vector from which to draw a category</param>
 	/// <param name="randomEngine">Random engine used for the draw</param>
 	/// <returns>The name of the drawn category</returns>
-	std::string GetRandomCategory(std::vector<std::tuple<int, std::string>> probabilities, std::default_random_engine& randomEngine);
+	std::string GetRandomCategory(std::vector<std::tuple<int, std::string>>& probabilities, std::default_random_engine& randomEngine);
 	/// <summary>
 	/// Draw a random object from a specific library
 	/// </summary>
-	Object GetRandomObjectFromLibrary(std::default_random_engine& randomEngine, std::map<std::string, std::vector<Object>> objectMap, std::vector<std::tuple<int, std::string>> probabilities);
+	Object GetRandomObjectFromLibrary(std::default_random_engine& randomEngine, std::map<std::string, std::vector<Object>>& objectMap, std::vector<std::tuple<int, std::string>>& probabilities);
+	/// <summary>
+	/// Forget the categories and files drawn until now
+	/// </summary>
+	void ClearDrawHistory();
+	/// <summary>
+	/// Label of the objects with the given Wnids, for the point clouds
+	/// </summary>
+	/// <returns>The label, -1 (with a warning) if no object of the library has these Wnids</returns>
+	int GetLabel(const std::string& wnids) const;
+	/// <summary>
+	/// Write the label table, one "label wnids" line per label
+	/// </summary>
+	void WriteLabels(std::ostream& outputStream) const;
 
 public:
 	/// <summary>
@@ -60,5 +75,18 @@ public:
 	/// Probability of each class of small object 
 	/// </summary>
 	std::vector<std::tuple<int, std::string>> SmallObjectProbability;
+	/// <summary>
+	/// Categories drawn since the last ClearDrawHistory, the draws of a scene only depend on the probabilities and on the entries of these categories
+	/// </summary>
+	std::set<std::string> DrawnCategories;
+	/// <summary>
+	/// Mesh files of the objects drawn since the last ClearDrawHistory
+	/// </summary>
+	std::set<std::string> DrawnFiles;
+	/// <summary>
+	/// Label of each distinct Wnids field of the library, from 1 in lexicographic order (0 is the layout).
+	/// A field listing several wnids gets its own label, and non numeric wnids are labelled as well.
+	/// </summary>
+	std::map<std::string, int> Labels;
 };
 
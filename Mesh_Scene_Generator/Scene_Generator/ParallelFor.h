@@ -0,0 +1,29 @@
+#pragma once
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <functional>
+#include <algorithm>
+
+/// <summary>
+/// Call task(i) for every i in [0, numberOfTasks), tasks being dynamically dispatched over the threads.
+/// The calling thread works too, so that no thread is started for a single task.
+/// </summary>
+/// <param name="numberOfThreads">Number of threads working on the tasks, the calling one included</param>
+inline void ParallelFor(size_t numberOfTasks, int numberOfThreads, const std::function<void(size_t)>& task)
+{
+	std::atomic<size_t> nextTask(0);
+	auto worker = [&]()
+	{
+		for (size_t i = nextTask++; i < numberOfTasks; i = nextTask++)
+			task(i);
+	};
+
+	int threadsToStart = (int)std::min<size_t>(std::max(1, numberOfThreads), numberOfTasks) - 1;
+	std::vector<std::thread> threads;
+	for (int i = 0; i < threadsToStart; i++)
+		threads.emplace_back(worker);
+	worker();
+	for (auto& thread : threads)
+		thread.join();
+}
@@ -0,0 +1,202 @@
+#include "PhysicsTelemetry.h"
+#include <cmath>
+#include <algorithm>
+#include <limits>
+
+
+FixedHistogram::FixedHistogram(double minValue, double maxValue, int numberOfBins)
+{
+    MinValue = minValue;
+    LogMin = std::log10(minValue);
+    BinsPerLog = numberOfBins / (std::log10(maxValue) - LogMin);
+    // The first bin gets the values under minValue, the last one those over maxValue
+    Bins.assign(numberOfBins + 2, 0);
+    Count = 0;
+}
+
+void FixedHistogram::Add(double value)
+{
+    size_t bin = 0;
+    if (value >= MinValue)
+        bin = std::min(Bins.size() - 1, (size_t)((std::log10(value) - LogMin) * BinsPerLog) + 1);
+    Bins[bin]++;
+    Count++;
+}
+
+double FixedHistogram::GetQuantile(double fraction)
+{
+    if (Count == 0)
+        return 0.0;
+
+    uint64_t target = (uint64_t)std::ceil(fraction * Count);
+    uint64_t cumulated = 0;
+    for (size_t bin = 0; bin < Bins.size(); bin++)
+    {
+        cumulated += Bins[bin];
+        if (cumulated >= target && cumulated > 0)
+            return std::pow(10.0, LogMin + bin / BinsPerLog);
+    }
+    return std::pow(10.0, LogMin + (Bins.size() - 1) / BinsPerLog);
+}
+
+
+bool PenetrationCounter::OnReportContact(const chrono::ChVector<>& pA,
+    const chrono::ChVector<>& pB,
+    const chrono::ChMatrix33<>& plane_coord,
+    const double& distance,
+    const double& eff_radius,
+    const chrono::ChVector<>& react_forces,
+    const chrono::ChVector<>& react_torques,
+    chrono::ChContactable* modA,
+    chrono::ChContactable* modB)
+{
+    if (distance < Threshold)
+        Count++;
+    Deepest = std::min(Deepest, distance);
+    return true;
+}
+
+
+PhysicsTelemetry::PhysicsTelemetry(int historySize, double penetrationSamplePeriod)
+{
+    PenetrationThreshold = -0.05;
+    PenetrationSamplePeriod = penetrationSamplePeriod;
+    LastSampleTime = -std::numeric_limits<double>::infinity();
+    CurrentPhase = -1;
+    History.resize(std::max(1, historySize));
+    HistoryHead = 0;
+    HistoryCount = 0;
+    Counter = std::make_shared<PenetrationCounter>();
+    SetPhase("default");
+}
+
+void PhysicsTelemetry::SetPhase(std::string name)
+{
+    for (size_t i = 0; i < Phases.size(); i++)
+    {
+        if (Phases[i].Name == name)
+        {
+            CurrentPhase = (int)i;
+            return;
+        }
+    }
+
+    PhaseStatistics phase;
+    phase.Name = name;
+    phase.Steps = 0;
+    phase.TotalWallTime = 0.0;
+    phase.MaxWallTime = 0.0;
+    phase.TotalContacts = 0;
+    phase.MaxContacts = 0;
+    phase.TotalDeepPenetrations = 0;
+    phase.SampledSteps = 0;
+    phase.TotalSolverIterations = 0;
+    phase.MaxSolverResidual = 0.0;
+    phase.WallTimeHistogram = FixedHistogram(1e-5, 10.0, 36);
+    phase.ContactsHistogram = FixedHistogram(1.0, 1e6, 36);
+    Phases.push_back(phase);
+    CurrentPhase = (int)Phases.size() - 1;
+}
+
+void PhysicsTelemetry::BeginStep()
+{
+    StepStart = std::chrono::steady_clock::now();
+}
+
+void PhysicsTelemetry::EndStep(chrono::ChSystem& mphysicalSystem)
+{
+    // The wall time is measured first, so that the recording cost is not attributed to the step
+    std::chrono::duration<double> wallTime = std::chrono::steady_clock::now() - StepStart;
+
+    StepSample sample;
+    sample.Time = mphysicalSystem.GetChTime();
+    sample.WallTime = wallTime.count();
+    sample.Contacts = mphysicalSystem.GetNcontacts();
+    sample.SleepingBodies = mphysicalSystem.GetNbodiesSleeping();
+    sample.ActiveBodies = mphysicalSystem.GetNbodies();
+    sample.SolverIterations = 0;
+    sample.SolverResidual = 0.0;
+    sample.Phase = CurrentPhase;
+
+    std::shared_ptr<chrono::ChIterativeSolver> solver = std::dynamic_pointer_cast<chrono::ChIterativeSolver>(mphysicalSystem.GetSolver());
+    if (solver)
+    {
+        sample.SolverIterations = solver->GetIterations();
+        sample.SolverResidual = solver->GetError();
+    }
+
+    // Going over the contacts is the only costly counter, so it is only done from time to time.
+    // The period is in simulated time, so that the sampling does not follow the step size chosen by the timestep controller.
+    sample.DeepPenetrations = -1;
+    sample.DeepestContact = 0.0;
+    if (sample.Time < LastSampleTime)
+        LastSampleTime = sample.Time;
+    if (sample.Time - LastSampleTime >= PenetrationSamplePeriod * (1.0 - 1e-6))
+    {
+        LastSampleTime = sample.Time;
+        Counter->Threshold = PenetrationThreshold;
+        Counter->Count = 0;
+        Counter->Deepest = 0.0;
+        mphysicalSystem.GetContactContainer()->ReportAllContacts(Counter);
+        sample.DeepPenetrations = Counter->Count;
+        sample.DeepestContact = Counter->Deepest;
+    }
+
+    History[HistoryHead] = sample;
+    HistoryHead = (HistoryHead + 1) % History.size();
+    HistoryCount = std::min(HistoryCount + 1, History.size());
+
+    PhaseStatistics& phase = Phases[CurrentPhase];
+    phase.Steps++;
+    phase.TotalWallTime += sample.WallTime;
+    phase.MaxWallTime = std::max(phase.MaxWallTime, sample.WallTime);
+    phase.TotalContacts += sample.Contacts;
+    phase.MaxContacts = std::max(phase.MaxContacts, sample.Contacts);
+    if (sample.DeepPenetrations >= 0)
+    {
+        phase.TotalDeepPenetrations += sample.DeepPenetrations;
+        phase.SampledSteps++;
+    }
+    phase.TotalSolverIterations += sample.SolverIterations;
+    phase.MaxSolverResidual = std::max(phase.MaxSolverResidual, sample.SolverResidual);
+    phase.WallTimeHistogram.Add(sample.WallTime);
+    phase.ContactsHistogram.Add(sample.Contacts);
+}
+
+const StepSample& PhysicsTelemetry::GetLastStep()
+{
+    return History[(HistoryHead + History.size() - 1) % History.size()];
+}
+
+void PhysicsTelemetry::PrintReport(std::ostream& outputStream)
+{
+    outputStream << "Physics telemetry :" << std::endl;
+    for (auto& phase : Phases)
+    {
+        if (phase.Steps == 0)
+            continue;
+
+        outputStream << "  " << phase.Name << " : " << phase.Steps << " steps, "
+            << phase.TotalWallTime << " s (" << 1000.0 * phase.TotalWallTime / phase.Steps << " ms/step, p95 "
+            << 1000.0 * phase.WallTimeHistogram.GetQuantile(0.95) << " ms, max " << 1000.0 * phase.MaxWallTime << " ms)" << std::endl;
+        outputStream << "    contacts : " << (double)phase.TotalContacts / phase.Steps << " mean, "
+            << phase.ContactsHistogram.GetQuantile(0.95) << " p95, " << phase.MaxContacts << " max" << std::endl;
+        if (phase.SampledSteps > 0)
+            outputStream << "    deep penetrations : " << (double)phase.TotalDeepPenetrations / phase.SampledSteps << " mean over " << phase.SampledSteps << " sampled steps" << std::endl;
+        outputStream << "    solver : " << (double)phase.TotalSolverIterations / phase.Steps << " iterations mean, "
+            << phase.MaxSolverResidual << " max residual" << std::endl;
+    }
+}
+
+void PhysicsTelemetry::WriteHistory(std::ostream& outputStream)
+{
+    outputStream << "time,wall_time,phase,contacts,deep_penetrations,active_bodies,sleeping_bodies,solver_iterations,solver_residual" << std::endl;
+    size_t first = (HistoryHead + History.size() - HistoryCount) % History.size();
+    for (size_t i = 0; i < HistoryCount; i++)
+    {
+        StepSample& sample = History[(first + i) % History.size()];
+        outputStream << sample.Time << "," << sample.WallTime << "," << Phases[sample.Phase].Name << ","
+            << sample.Contacts << "," << sample.DeepPenetrations << "," << sample.ActiveBodies << "," << sample.SleepingBodies << ","
+            << sample.SolverIterations << "," << sample.SolverResidual << std::endl;
+    }
+}
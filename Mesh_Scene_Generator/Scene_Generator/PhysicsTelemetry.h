@@ -0,0 +1,188 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <chrono>
+#include <ostream>
+#include <cstdint>
+#include <memory>
+#include "chrono/physics/ChSystem.h"
+#include "chrono/physics/ChContactContainer.h"
+#include "chrono/solver/ChIterativeSolver.h"
+
+/// <summary>
+/// Counters recorded for one simulation step
+/// </summary>
+struct StepSample
+{
+	/// <summary>
+	/// Simulation time at the end of the step (s)
+	/// </summary>
+	double Time;
+	/// <summary>
+	/// Wall time spent in the step (s)
+	/// </summary>
+	double WallTime;
+	/// <summary>
+	/// Number of contacts at the end of the step
+	/// </summary>
+	int Contacts;
+	/// <summary>
+	/// Number of contacts deeper than the penetration threshold, -1 if not sampled during this step
+	/// </summary>
+	int DeepPenetrations;
+	/// <summary>
+	/// Smallest signed distance of the contacts (m, negative when penetrating), only meaningful when DeepPenetrations was sampled
+	/// </summary>
+	double DeepestContact;
+	/// <summary>
+	/// Number of bodies neither fixed nor sleeping
+	/// </summary>
+	int ActiveBodies;
+	int SleepingBodies;
+	/// <summary>
+	/// Iterations done by the solver, and its final residual (0 if the solver is not iterative)
+	/// </summary>
+	int SolverIterations;
+	double SolverResidual;
+	/// <summary>
+	/// Index of the phase during which the step was done
+	/// </summary>
+	int Phase;
+};
+
+/// <summary>
+/// Histogram with a fixed number of bins, logarithmically spaced between a minimum and a maximum value
+/// </summary>
+class FixedHistogram
+{
+public:
+	FixedHistogram(double minValue = 1e-6, double maxValue = 1.0, int numberOfBins = 32);
+	void Add(double value);
+	/// <summary>
+	/// Approximate value under which a given fraction of the recorded values lies (upper bound of the bin)
+	/// </summary>
+	double GetQuantile(double fraction);
+	/// <summary>
+	/// Number of recorded values
+	/// </summary>
+	uint64_t GetCount() { return Count; }
+
+private:
+	double MinValue;
+	double LogMin;
+	double BinsPerLog;
+	std::vector<uint64_t> Bins;
+	uint64_t Count;
+};
+
+/// <summary>
+/// Aggregated counters of a simulation phase (eg : large objects settling)
+/// </summary>
+struct PhaseStatistics
+{
+	std::string Name;
+	uint64_t Steps;
+	/// <summary>
+	/// Wall time spent in the steps of the phase (s)
+	/// </summary>
+	double TotalWallTime;
+	double MaxWallTime;
+	uint64_t TotalContacts;
+	int MaxContacts;
+	/// <summary>
+	/// Deep penetrations are only counted during the sampled steps
+	/// </summary>
+	uint64_t TotalDeepPenetrations;
+	uint64_t SampledSteps;
+	uint64_t TotalSolverIterations;
+	double MaxSolverResidual;
+	FixedHistogram WallTimeHistogram;
+	FixedHistogram ContactsHistogram;
+};
+
+/// <summary>
+/// Count the contacts deeper than a threshold, and find the deepest one
+/// </summary>
+class PenetrationCounter : public chrono::ChContactContainer::ReportContactCallback
+{
+public:
+	virtual bool OnReportContact(const chrono::ChVector<>& pA,
+		const chrono::ChVector<>& pB,
+		const chrono::ChMatrix33<>& plane_coord,
+		const double& distance,
+		const double& eff_radius,
+		const chrono::ChVector<>& react_forces,
+		const chrono::ChVector<>& react_torques,
+		chrono::ChContactable* modA,
+		chrono::ChContactable* modB) override;
+
+	double Threshold = -0.05;
+	int Count = 0;
+	double Deepest = 0.0;
+};
+
+/// <summary>
+/// Low overhead recorder of what the physics engine does at each step : contacts, sleeping bodies, solver work and step duration.
+/// Memory is allocated once, so it can stay enabled during production runs.
+/// </summary>
+class PhysicsTelemetry
+{
+public:
+	/// <summary>
+	/// Build a telemetry recorder
+	/// </summary>
+	/// <param name="historySize">Number of last steps kept in the ring buffer</param>
+	/// <param name="penetrationSamplePeriod">Deep penetrations are counted once every penetrationSamplePeriod seconds of simulated time, as it requires going over every contact</param>
+	PhysicsTelemetry(int historySize = 4096, double penetrationSamplePeriod = 0.1);
+	/// <summary>
+	/// Following steps are attributed to the given phase
+	/// </summary>
+	void SetPhase(std::string name);
+	/// <summary>
+	/// To be called just before a simulation step
+	/// </summary>
+	void BeginStep();
+	/// <summary>
+	/// To be called just after a simulation step, record the step counters
+	/// </summary>
+	/// <param name="mphysicalSystem">The physical engine which has done the step</param>
+	void EndStep(chrono::ChSystem& mphysicalSystem);
+	/// <summary>
+	/// Counters of the last recorded step, to be called after EndStep
+	/// </summary>
+	const StepSample& GetLastStep();
+	/// <summary>
+	/// Write the statistics of each phase
+	/// </summary>
+	void PrintReport(std::ostream& outputStream);
+	/// <summary>
+	/// Write the steps kept in the ring buffer, as comma separated values, from the oldest to the newest
+	/// </summary>
+	void WriteHistory(std::ostream& outputStream);
+
+public:
+	/// <summary>
+	/// Contact distance (negative, m) under which a contact is counted as a deep penetration
+	/// </summary>
+	double PenetrationThreshold;
+	/// <summary>
+	/// Statistics of every phase, in order of first use
+	/// </summary>
+	std::vector<PhaseStatistics> Phases;
+
+private:
+	double PenetrationSamplePeriod;
+	double LastSampleTime;
+	int CurrentPhase;
+	std::chrono::steady_clock::time_point StepStart;
+	/// <summary>
+	/// Last recorded steps, History[HistoryHead] being the next to be overwritten
+	/// </summary>
+	std::vector<StepSample> History;
+	size_t HistoryHead;
+	size_t HistoryCount;
+	/// <summary>
+	/// Reused at each sampled step, to avoid allocations
+	/// </summary>
+	std::shared_ptr<PenetrationCounter> Counter;
+};
@@ -1,7 +1,8 @@
 #include "PlacedObject.h"
 
-PlacedObject::PlacedObject(Object baseObject, double scale, std::shared_ptr<chrono::ChBody> collisionBody) : BaseObject(baseObject)
+PlacedObject::PlacedObject(Object baseObject, double scale, std::shared_ptr<chrono::ChBody> collisionBody, std::shared_ptr<chrono::geometry::ChTriangleMeshConnected> mesh) : BaseObject(baseObject)
 {
 	Scale = scale;
 	CollisionBody = collisionBody;
+	Mesh = mesh;
 }
\ No newline at end of file
@@ -13,7 +13,8 @@ public:
 	/// <param name="baseObject">Mesh representation of the placed object</param>
 	/// <param name="scale">Scale of the object in the scene compared to the object mesh definition</param>
 	/// <param name="collisionBody">Collision body used in the simulation</param>
-	PlacedObject(Object baseObject, double scale, std::shared_ptr<chrono::ChBody> collisionBody);
+	/// <param name="mesh">Scaled mesh of the object, in the body frame</param>
+	PlacedObject(Object baseObject, double scale, std::shared_ptr<chrono::ChBody> collisionBody, std::shared_ptr<chrono::geometry::ChTriangleMeshConnected> mesh);
 
 public:
 	/// <summary>
@@ -28,5 +29,9 @@ public:
 	/// The collision body representing the object in the physics simulator
 	/// </summary>
 	std::shared_ptr<chrono::ChBody> CollisionBody;
+	/// <summary>
+	/// The scaled mesh of the object, expressed in the collision body frame
+	/// </summary>
+	std::shared_ptr<chrono::geometry::ChTriangleMeshConnected> Mesh;
 };
 
@@ -0,0 +1,501 @@
+#include "PointCloudProcessor.h"
+#include <thread>
+#include <numeric>
+#include <fstream>
+#include <chrono>
+#include <cstdint>
+#include <Eigen/Dense>
+#include "ParallelFor.h"
+#include "SpatialHash.h"
+#include "Log.h"
+
+
+namespace
+{
+    // Random draws are done by chunks of fixed size, so that results do not depend on the number of threads
+    const size_t ChunkSize = 1 << 16;
+    // Voxels are reduced independently in each partition of the hash space
+    const int NumberOfPartitions = 64;
+
+    size_t GetNumberOfChunks(size_t numberOfPoints)
+    {
+        return (numberOfPoints + ChunkSize - 1) / ChunkSize;
+    }
+
+    int64_t GetCellIndex(float coordinate, float inverseCellSize)
+    {
+        return (int64_t)std::floor(coordinate * inverseCellSize);
+    }
+
+    int GetPartition(uint64_t key)
+    {
+        return (int)((key * 0x9E3779B97F4A7C15ull) >> 58);
+    }
+
+    // Cell key of every point of the cloud
+    std::vector<uint64_t> ComputeCellKeys(const PointCloud& cloud, float cellSize, int numberOfThreads)
+    {
+        std::vector<uint64_t> keys(cloud.Size());
+        float inverseCellSize = 1.0f / cellSize;
+        ParallelFor(GetNumberOfChunks(cloud.Size()), numberOfThreads, [&](size_t chunk)
+        {
+            size_t end = std::min(cloud.Size(), (chunk + 1) * ChunkSize);
+            for (size_t i = chunk * ChunkSize; i < end; i++)
+                keys[i] = GetCellKey(GetCellIndex(cloud.X[i], inverseCellSize), GetCellIndex(cloud.Y[i], inverseCellSize), GetCellIndex(cloud.Z[i], inverseCellSize));
+        });
+        return keys;
+    }
+}
+
+
+void PointCloud::Resize(size_t size)
+{
+    X.resize(size);
+    Y.resize(size);
+    Z.resize(size);
+    Labels.resize(size);
+    if (NX.size() > 0)
+    {
+        NX.resize(size);
+        NY.resize(size);
+        NZ.resize(size);
+    }
+}
+
+void PointCloud::Reserve(size_t size)
+{
+    X.reserve(size);
+    Y.reserve(size);
+    Z.reserve(size);
+    Labels.reserve(size);
+}
+
+void PointCloud::Append(const PointCloud& other)
+{
+    X.insert(X.end(), other.X.begin(), other.X.end());
+    Y.insert(Y.end(), other.Y.begin(), other.Y.end());
+    Z.insert(Z.end(), other.Z.begin(), other.Z.end());
+    Labels.insert(Labels.end(), other.Labels.begin(), other.Labels.end());
+    NX.insert(NX.end(), other.NX.begin(), other.NX.end());
+    NY.insert(NY.end(), other.NY.begin(), other.NY.end());
+    NZ.insert(NZ.end(), other.NZ.begin(), other.NZ.end());
+}
+
+
+PointCloudProcessor::PointCloudProcessor()
+{
+    NumberOfThreads = std::max(1, (int)std::thread::hardware_concurrency());
+    Seed = 0;
+    SamplingDensity = 20000.0;
+    VoxelSize = 0.01f;
+    NormalRadius = 0.05f;
+    SensorPosition = chrono::Vector(0.0, 1.6, 0.0);
+    NoiseBase = 0.002f;
+    NoisePerSquareMeter = 0.0015f;
+    DropoutBase = 0.02f;
+    DropoutPerMeter = 0.01f;
+    DropoutGrazing = 0.2f;
+    RangeResolution = 0.001f;
+}
+
+PointCloud PointCloudProcessor::SampleScene(Scene& scene, std::vector<PlacedObject>& objects, const ObjectLibrary& library)
+{
+    struct SampledMesh
+    {
+        std::shared_ptr<chrono::geometry::ChTriangleMeshConnected> Mesh;
+        std::shared_ptr<chrono::ChBody> Body;
+        int Label;
+    };
+
+    std::vector<SampledMesh> meshes;
+    if (scene.LayoutMesh && scene.SceneLayout)
+        meshes.push_back({ scene.LayoutMesh, scene.SceneLayout, 0 });
+    for (auto& object : objects)
+        if (object.Mesh)
+            meshes.push_back({ object.Mesh, object.CollisionBody, library.GetLabel(object.BaseObject.Wnids) });
+
+    std::vector<PointCloud> parts(meshes.size());
+    ParallelFor(meshes.size(), NumberOfThreads, [&](size_t m)
+    {
+        std::seed_seq seed{ Seed, 0u, (unsigned int)m };
+        std::mt19937 randomEngine(seed);
+        std::uniform_real_distribution<double> uniform(0.0, 1.0);
+        std::vector<chrono::ChVector<double>>& vertices = meshes[m].Mesh->getCoordsVertices();
+        std::vector<chrono::ChVector<int>>& faces = meshes[m].Mesh->getIndicesVertexes();
+        PointCloud& part = parts[m];
+
+        for (auto& face : faces)
+        {
+            chrono::Vector a = meshes[m].Body->TransformPointLocalToParent(vertices[face[0]]);
+            chrono::Vector ab = meshes[m].Body->TransformPointLocalToParent(vertices[face[1]]) - a;
+            chrono::Vector ac = meshes[m].Body->TransformPointLocalToParent(vertices[face[2]]) - a;
+            // Fractional number of points handled randomly, so that small triangles are still sampled
+            int numberOfPoints = (int)(0.5 * Vcross(ab, ac).Length() * SamplingDensity + uniform(randomEngine));
+            for (int k = 0; k < numberOfPoints; k++)
+            {
+                double r1 = std::sqrt(uniform(randomEngine));
+                double r2 = uniform(randomEngine);
+                chrono::Vector point = a + ab * (r1 * (1.0 - r2)) + ac * (r1 * r2);
+                part.X.push_back((float)point[0]);
+                part.Y.push_back((float)point[1]);
+                part.Z.push_back((float)point[2]);
+                part.Labels.push_back(meshes[m].Label);
+            }
+        }
+    });
+
+    size_t total = 0;
+    for (auto& part : parts)
+        total += part.Size();
+    PointCloud cloud;
+    cloud.Reserve(total);
+    for (auto& part : parts)
+        cloud.Append(part);
+    return cloud;
+}
+
+void PointCloudProcessor::Process(PointCloud& cloud)
+{
+    auto start = std::chrono::steady_clock::now();
+    size_t inputSize = cloud.Size();
+
+    if (VoxelSize > 0.0f)
+        VoxelDownsample(cloud, VoxelSize);
+    if (NormalRadius > 0.0f)
+        EstimateNormals(cloud, NormalRadius);
+    AddRangeNoise(cloud);
+    Dropout(cloud);
+    if (RangeResolution > 0.0f)
+        QuantizeRange(cloud);
+
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    Log::Out() << "Point cloud processed : " << inputSize << " -> " << cloud.Size() << " points in " << elapsed << " s" << std::endl;
+}
+
+void PointCloudProcessor::VoxelDownsample(PointCloud& cloud, float voxelSize)
+{
+    size_t numberOfPoints = cloud.Size();
+    if (numberOfPoints == 0)
+        return;
+
+    std::vector<uint64_t> keys = ComputeCellKeys(cloud, voxelSize, NumberOfThreads);
+
+    // Points are grouped by partition of the hash space, keeping their original order inside a partition
+    size_t numberOfChunks = GetNumberOfChunks(numberOfPoints);
+    std::vector<size_t> offsets(numberOfChunks * NumberOfPartitions, 0);
+    ParallelFor(numberOfChunks, NumberOfThreads, [&](size_t chunk)
+    {
+        size_t end = std::min(numberOfPoints, (chunk + 1) * ChunkSize);
+        for (size_t i = chunk * ChunkSize; i < end; i++)
+            offsets[chunk * NumberOfPartitions + GetPartition(keys[i])]++;
+    });
+
+    std::vector<size_t> partitionStart(NumberOfPartitions + 1);
+    size_t runningOffset = 0;
+    for (int p = 0; p < NumberOfPartitions; p++)
+    {
+        partitionStart[p] = runningOffset;
+        for (size_t chunk = 0; chunk < numberOfChunks; chunk++)
+        {
+            size_t count = offsets[chunk * NumberOfPartitions + p];
+            offsets[chunk * NumberOfPartitions + p] = runningOffset;
+            runningOffset += count;
+        }
+    }
+    partitionStart[NumberOfPartitions] = runningOffset;
+
+    // Points are copied, rather than indexed, so that each partition is then read sequentially
+    struct PartitionedPoint
+    {
+        uint64_t Key;
+        float X, Y, Z;
+        int Label;
+    };
+    std::vector<PartitionedPoint> partitioned(numberOfPoints);
+    ParallelFor(numberOfChunks, NumberOfThreads, [&](size_t chunk)
+    {
+        size_t* chunkOffsets = &offsets[chunk * NumberOfPartitions];
+        size_t end = std::min(numberOfPoints, (chunk + 1) * ChunkSize);
+        for (size_t i = chunk * ChunkSize; i < end; i++)
+            partitioned[chunkOffsets[GetPartition(keys[i])]++] = PartitionedPoint{ keys[i], cloud.X[i], cloud.Y[i], cloud.Z[i], cloud.Labels[i] };
+    });
+
+    // Each partition is reduced on its own, no synchronisation is needed
+    std::vector<PointCloud> parts(NumberOfPartitions);
+    ParallelFor(NumberOfPartitions, NumberOfThreads, [&](size_t p)
+    {
+        // A voxel usually holds several points, the map grows if needed
+        CellMap voxels((partitionStart[p + 1] - partitionStart[p]) / 8);
+        std::vector<double> sumX, sumY, sumZ;
+        std::vector<uint32_t> counts;
+        PointCloud& part = parts[p];
+
+        for (size_t j = partitionStart[p]; j < partitionStart[p + 1]; j++)
+        {
+            const PartitionedPoint& point = partitioned[j];
+            bool inserted;
+            uint32_t v = voxels.Insert(point.Key, (uint32_t)counts.size(), inserted);
+            if (inserted)
+            {
+                sumX.push_back(0.0);
+                sumY.push_back(0.0);
+                sumZ.push_back(0.0);
+                counts.push_back(0);
+                part.Labels.push_back(point.Label);
+            }
+            sumX[v] += point.X;
+            sumY[v] += point.Y;
+            sumZ[v] += point.Z;
+            counts[v]++;
+        }
+
+        part.X.resize(counts.size());
+        part.Y.resize(counts.size());
+        part.Z.resize(counts.size());
+        for (size_t v = 0; v < counts.size(); v++)
+        {
+            part.X[v] = (float)(sumX[v] / counts[v]);
+            part.Y[v] = (float)(sumY[v] / counts[v]);
+            part.Z[v] = (float)(sumZ[v] / counts[v]);
+        }
+    });
+
+    PointCloud downsampled;
+    size_t total = 0;
+    for (auto& part : parts)
+        total += part.Size();
+    downsampled.Reserve(total);
+    for (auto& part : parts)
+        downsampled.Append(part);
+    cloud = std::move(downsampled);
+}
+
+void PointCloudProcessor::EstimateNormals(PointCloud& cloud, float radius)
+{
+    // First and second order moments of the points of a cell
+    struct CellMoments
+    {
+        double Count, X, Y, Z, XX, XY, XZ, YY, YZ, ZZ;
+    };
+
+    size_t numberOfPoints = cloud.Size();
+    std::vector<uint64_t> keys = ComputeCellKeys(cloud, radius, NumberOfThreads);
+
+    // Moments are computed once per cell, the neighbourhood of a point then only costs 27 cell lookups
+    CellMap cells(numberOfPoints / 8);
+    std::vector<CellMoments> moments;
+    for (size_t i = 0; i < numberOfPoints; i++)
+    {
+        bool inserted;
+        uint32_t c = cells.Insert(keys[i], (uint32_t)moments.size(), inserted);
+        if (inserted)
+            moments.push_back(CellMoments{ 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0 });
+        double x = cloud.X[i], y = cloud.Y[i], z = cloud.Z[i];
+        CellMoments& m = moments[c];
+        m.Count += 1.0;
+        m.X += x;
+        m.Y += y;
+        m.Z += z;
+        m.XX += x * x;
+        m.XY += x * y;
+        m.XZ += x * z;
+        m.YY += y * y;
+        m.YZ += y * z;
+        m.ZZ += z * z;
+    }
+
+    cloud.NX.resize(numberOfPoints);
+    cloud.NY.resize(numberOfPoints);
+    cloud.NZ.resize(numberOfPoints);
+    float inverseRadius = 1.0f / radius;
+    double sensorX = SensorPosition[0], sensorY = SensorPosition[1], sensorZ = SensorPosition[2];
+
+    ParallelFor(GetNumberOfChunks(numberOfPoints), NumberOfThreads, [&](size_t chunk)
+    {
+        Eigen::SelfAdjointEigenSolver<Eigen::Matrix3d> solver;
+        size_t end = std::min(numberOfPoints, (chunk + 1) * ChunkSize);
+        for (size_t i = chunk * ChunkSize; i < end; i++)
+        {
+            int64_t ci = GetCellIndex(cloud.X[i], inverseRadius), cj = GetCellIndex(cloud.Y[i], inverseRadius), ck = GetCellIndex(cloud.Z[i], inverseRadius);
+
+            // The neighbourhood is the block of 3x3x3 cells around the point
+            CellMoments sum = { 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0 };
+            for (int di = -1; di <= 1; di++)
+                for (int dj = -1; dj <= 1; dj++)
+                    for (int dk = -1; dk <= 1; dk++)
+                    {
+                        int64_t c = cells.Find(GetCellKey(ci + di, cj + dj, ck + dk));
+                        if (c < 0)
+                            continue;
+                        const CellMoments& m = moments[c];
+                        sum.Count += m.Count;
+                        sum.X += m.X;
+                        sum.Y += m.Y;
+                        sum.Z += m.Z;
+                        sum.XX += m.XX;
+                        sum.XY += m.XY;
+                        sum.XZ += m.XZ;
+                        sum.YY += m.YY;
+                        sum.YZ += m.YZ;
+                        sum.ZZ += m.ZZ;
+                    }
+
+            Eigen::Vector3d toSensor(sensorX - cloud.X[i], sensorY - cloud.Y[i], sensorZ - cloud.Z[i]);
+            Eigen::Vector3d normal;
+            if (sum.Count < 3.0)
+                normal = toSensor.normalized();
+            else
+            {
+                Eigen::Vector3d mean(sum.X / sum.Count, sum.Y / sum.Count, sum.Z / sum.Count);
+                Eigen::Matrix3d covariance;
+                covariance << sum.XX / sum.Count, sum.XY / sum.Count, sum.XZ / sum.Count,
+                    sum.XY / sum.Count, sum.YY / sum.Count, sum.YZ / sum.Count,
+                    sum.XZ / sum.Count, sum.YZ / sum.Count, sum.ZZ / sum.Count;
+                covariance -= mean * mean.transpose();
+                solver.computeDirect(covariance);
+                // Eigen values are sorted in increasing order
+                normal = solver.eigenvectors().col(0);
+                if (normal.dot(toSensor) < 0.0)
+                    normal = -normal;
+            }
+            cloud.NX[i] = (float)normal[0];
+            cloud.NY[i] = (float)normal[1];
+            cloud.NZ[i] = (float)normal[2];
+        }
+    });
+}
+
+void PointCloudProcessor::AddRangeNoise(PointCloud& cloud)
+{
+    size_t numberOfPoints = cloud.Size();
+    float sensorX = (float)SensorPosition[0], sensorY = (float)SensorPosition[1], sensorZ = (float)SensorPosition[2];
+
+    ParallelFor(GetNumberOfChunks(numberOfPoints), NumberOfThreads, [&](size_t chunk)
+    {
+        size_t begin = chunk * ChunkSize;
+        size_t end = std::min(numberOfPoints, begin + ChunkSize);
+        // Draws are done first, so that the geometric loop below can be vectorized
+        std::seed_seq seed{ Seed, 1u, (unsigned int)chunk };
+        std::mt19937 randomEngine(seed);
+        std::normal_distribution<float> normalDistribution(0.0f, 1.0f);
+        std::vector<float> draws(end - begin);
+        for (auto& draw : draws)
+            draw = normalDistribution(randomEngine);
+
+        float* x = cloud.X.data() + begin;
+        float* y = cloud.Y.data() + begin;
+        float* z = cloud.Z.data() + begin;
+        for (size_t i = 0; i < end - begin; i++)
+        {
+            float dx = x[i] - sensorX, dy = y[i] - sensorY, dz = z[i] - sensorZ;
+            float range = std::sqrt(dx * dx + dy * dy + dz * dz) + 1e-6f;
+            float deviation = NoiseBase + NoisePerSquareMeter * range * range;
+            float factor = 1.0f + deviation * draws[i] / range;
+            x[i] = sensorX + dx * factor;
+            y[i] = sensorY + dy * factor;
+            z[i] = sensorZ + dz * factor;
+        }
+    });
+}
+
+void PointCloudProcessor::Dropout(PointCloud& cloud)
+{
+    size_t numberOfPoints = cloud.Size();
+    size_t numberOfChunks = GetNumberOfChunks(numberOfPoints);
+    bool hasNormals = cloud.NX.size() == numberOfPoints;
+    float sensorX = (float)SensorPosition[0], sensorY = (float)SensorPosition[1], sensorZ = (float)SensorPosition[2];
+
+    std::vector<uint8_t> kept(numberOfPoints);
+    std::vector<size_t> keptPerChunk(numberOfChunks + 1, 0);
+    ParallelFor(numberOfChunks, NumberOfThreads, [&](size_t chunk)
+    {
+        size_t begin = chunk * ChunkSize;
+        size_t end = std::min(numberOfPoints, begin + ChunkSize);
+        std::seed_seq seed{ Seed, 2u, (unsigned int)chunk };
+        std::mt19937 randomEngine(seed);
+        std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+        size_t count = 0;
+        for (size_t i = begin; i < end; i++)
+        {
+            float dx = cloud.X[i] - sensorX, dy = cloud.Y[i] - sensorY, dz = cloud.Z[i] - sensorZ;
+            float range = std::sqrt(dx * dx + dy * dy + dz * dz) + 1e-6f;
+            float probability = DropoutBase + DropoutPerMeter * range;
+            if (hasNormals)
+                probability += DropoutGrazing * (1.0f - std::abs(cloud.NX[i] * dx + cloud.NY[i] * dy + cloud.NZ[i] * dz) / range);
+            kept[i] = uniform(randomEngine) >= probability;
+            count += kept[i];
+        }
+        keptPerChunk[chunk + 1] = count;
+    });
+    std::partial_sum(keptPerChunk.begin(), keptPerChunk.end(), keptPerChunk.begin());
+
+    // Kept points are compacted in place : a chunk only writes before its own beginning, chunks are done in order
+    for (size_t chunk = 0; chunk < numberOfChunks; chunk++)
+    {
+        size_t target = keptPerChunk[chunk];
+        size_t end = std::min(numberOfPoints, (chunk + 1) * ChunkSize);
+        for (size_t i = chunk * ChunkSize; i < end; i++)
+        {
+            if (!kept[i])
+                continue;
+            cloud.X[target] = cloud.X[i];
+            cloud.Y[target] = cloud.Y[i];
+            cloud.Z[target] = cloud.Z[i];
+            cloud.Labels[target] = cloud.Labels[i];
+            if (hasNormals)
+            {
+                cloud.NX[target] = cloud.NX[i];
+                cloud.NY[target] = cloud.NY[i];
+                cloud.NZ[target] = cloud.NZ[i];
+            }
+            target++;
+        }
+    }
+    cloud.Resize(keptPerChunk[numberOfChunks]);
+}
+
+void PointCloudProcessor::QuantizeRange(PointCloud& cloud)
+{
+    size_t numberOfPoints = cloud.Size();
+    float sensorX = (float)SensorPosition[0], sensorY = (float)SensorPosition[1], sensorZ = (float)SensorPosition[2];
+    float inverseResolution = 1.0f / RangeResolution;
+
+    ParallelFor(GetNumberOfChunks(numberOfPoints), NumberOfThreads, [&](size_t chunk)
+    {
+        size_t begin = chunk * ChunkSize;
+        size_t count = std::min(numberOfPoints, begin + ChunkSize) - begin;
+        float* x = cloud.X.data() + begin;
+        float* y = cloud.Y.data() + begin;
+        float* z = cloud.Z.data() + begin;
+        // Branch free loop, so that it can be vectorized
+        for (size_t i = 0; i < count; i++)
+        {
+            float dx = x[i] - sensorX, dy = y[i] - sensorY, dz = z[i] - sensorZ;
+            float range = std::sqrt(dx * dx + dy * dy + dz * dz) + 1e-6f;
+            float quantizedRange = std::floor(range * inverseResolution + 0.5f) * RangeResolution;
+            float factor = quantizedRange / range;
+            x[i] = sensorX + dx * factor;
+            y[i] = sensorY + dy * factor;
+            z[i] = sensorZ + dz * factor;
+        }
+    });
+}
+
+bool PointCloudProcessor::Save(const PointCloud& cloud, std::string filePath)
+{
+    std::ofstream outputStream(filePath);
+    if (!outputStream)
+        return false;
+
+    bool hasNormals = cloud.NX.size() == cloud.Size();
+    for (size_t i = 0; i < cloud.Size(); i++)
+    {
+        outputStream << cloud.X[i] << " " << cloud.Y[i] << " " << cloud.Z[i] << " ";
+        if (hasNormals)
+            outputStream << cloud.NX[i] << " " << cloud.NY[i] << " " << cloud.NZ[i] << " ";
+        else
+            outputStream << "0 0 0 ";
+        outputStream << cloud.Labels[i] << "\n";
+    }
+    return outputStream.good();
+}
@@ -0,0 +1,122 @@
+#pragma once
+#include <vector>
+#include <string>
+#include "Scene.h"
+
+/// <summary>
+/// Labeled point cloud, stored as one array per coordinate so that the processing loops can be vectorized
+/// </summary>
+struct PointCloud
+{
+	/// <summary>
+	/// Coordinates of the points, in the world frame (m)
+	/// </summary>
+	std::vector<float> X, Y, Z;
+	/// <summary>
+	/// Normals, empty until estimated
+	/// </summary>
+	std::vector<float> NX, NY, NZ;
+	/// <summary>
+	/// Label of each point (see ObjectLibrary::Labels, 0 for the layout, -1 for an object whose Wnids are not in the library)
+	/// </summary>
+	std::vector<int> Labels;
+
+	size_t Size() const { return X.size(); }
+	void Resize(size_t size);
+	void Reserve(size_t size);
+	/// <summary>
+	/// Append every point of another cloud
+	/// </summary>
+	void Append(const PointCloud& other);
+};
+
+/// <summary>
+/// Turn the meshes of a simulated scene into a point cloud looking like a real scanner acquisition :
+/// surface sampling, voxel grid downsampling, normal estimation, range dependent noise, dropout and range quantization
+/// </summary>
+class PointCloudProcessor
+{
+public:
+	/// <summary>
+	/// Build a processor with default settings, using every available core
+	/// </summary>
+	PointCloudProcessor();
+	/// <summary>
+	/// Sample points on the surface of the scene layout and of the given objects
+	/// </summary>
+	/// <param name="scene">The scene whose layout is sampled</param>
+	/// <param name="objects">The objects to sample, with their current pose</param>
+	/// <param name="library">The library of the objects, which gives their labels</param>
+	/// <returns>The sampled cloud</returns>
+	PointCloud SampleScene(Scene& scene, std::vector<PlacedObject>& objects, const ObjectLibrary& library);
+	/// <summary>
+	/// Apply every post processing step to a cloud, in order : downsampling, normals, noise, dropout, quantization
+	/// </summary>
+	void Process(PointCloud& cloud);
+	/// <summary>
+	/// Keep one point per voxel of the grid (the centroid of the voxel points, with the label of its first point)
+	/// </summary>
+	void VoxelDownsample(PointCloud& cloud, float voxelSize);
+	/// <summary>
+	/// Estimate the normal of each point from its neighbours, oriented toward the sensor
+	/// </summary>
+	void EstimateNormals(PointCloud& cloud, float radius);
+	/// <summary>
+	/// Move each point along the sensor ray, with a gaussian noise whose deviation grows with the range
+	/// </summary>
+	void AddRangeNoise(PointCloud& cloud);
+	/// <summary>
+	/// Randomly remove points, far and grazing points being more likely to be removed
+	/// </summary>
+	void Dropout(PointCloud& cloud);
+	/// <summary>
+	/// Round the range of each point to the sensor range resolution
+	/// </summary>
+	void QuantizeRange(PointCloud& cloud);
+	/// <summary>
+	/// Write a cloud as a text file, one "x y z nx ny nz label" line per point
+	/// </summary>
+	/// <returns>False if the file could not be written</returns>
+	bool Save(const PointCloud& cloud, std::string filePath);
+
+public:
+	/// <summary>
+	/// Number of worker threads
+	/// </summary>
+	int NumberOfThreads;
+	/// <summary>
+	/// Seed of the random draws, the result does not depend on the number of threads
+	/// </summary>
+	unsigned int Seed;
+	/// <summary>
+	/// Density of the surface sampling (points/m2)
+	/// </summary>
+	double SamplingDensity;
+	/// <summary>
+	/// Size of the downsampling voxels (m), no downsampling if 0
+	/// </summary>
+	float VoxelSize;
+	/// <summary>
+	/// Radius of the neighbourhood used to estimate the normals (m), no normals if 0
+	/// </summary>
+	float NormalRadius;
+	/// <summary>
+	/// Position of the simulated sensor
+	/// </summary>
+	chrono::Vector SensorPosition;
+	/// <summary>
+	/// Range noise deviation (m) : NoiseBase + NoisePerSquareMeter * range^2
+	/// </summary>
+	float NoiseBase;
+	float NoisePerSquareMeter;
+	/// <summary>
+	/// Probability to lose a point : DropoutBase + DropoutPerMeter * range + DropoutGrazing * (1 - |cos(incidence)|)
+	/// </summary>
+	float DropoutBase;
+	float DropoutPerMeter;
+	float DropoutGrazing;
+	/// <summary>
+	/// Range resolution of the sensor (m), no quantization if 0
+	/// </summary>
+	float RangeResolution;
+};
@@ -0,0 +1,120 @@
+#include "PreviewRenderer.h"
+#include <unordered_set>
+
+using namespace chrono;
+using namespace chrono::irrlicht;
+
+
+namespace
+{
+    // Irrlicht node asset of a bound body, nullptr if it has none
+    std::shared_ptr<ChIrrNodeAsset> GetNodeAsset(ChBody& body)
+    {
+        for (auto& asset : body.GetAssets())
+        {
+            auto nodeAsset = std::dynamic_pointer_cast<ChIrrNodeAsset>(asset);
+            if (nodeAsset)
+                return nodeAsset;
+        }
+        return nullptr;
+    }
+}
+
+PreviewRenderer::PreviewRenderer(ChIrrApp& application, int renderInterval, double framesPerSecond) :
+    Application(application)
+{
+    RenderInterval = renderInterval;
+    FramesPerSecond = framesPerSecond;
+    StepsSinceFrame = 0;
+    LastFrameTime = std::chrono::steady_clock::now();
+    TotalSteps = 0;
+    TotalFrames = 0;
+    // The frames are paced by the preview, the simulation itself runs as fast as it can
+    Application.SetTryRealtime(false);
+}
+
+void PreviewRenderer::Synchronize()
+{
+    const std::vector<std::shared_ptr<ChBody>>& bodies = Application.GetSystem()->Get_bodylist();
+    std::unordered_set<ChBody*> presentBodies;
+    presentBodies.reserve(bodies.size());
+
+    for (auto& body : bodies)
+    {
+        presentBodies.insert(body.get());
+        auto bound = BoundBodies.find(body.get());
+        if (bound != BoundBodies.end() && bound->second.lock() == body)
+            continue;
+
+        std::shared_ptr<ChIrrNodeAsset> nodeAsset = GetNodeAsset(*body);
+        if (nodeAsset && nodeAsset->GetIrrlichtNode())
+        {
+            // Body removed then added again, its meshes were already converted
+            nodeAsset->GetIrrlichtNode()->setVisible(true);
+        }
+        else
+        {
+            Application.AssetBind(body);
+            Application.AssetUpdate(body);
+        }
+        BoundBodies[body.get()] = body;
+    }
+
+    for (auto bound = BoundBodies.begin(); bound != BoundBodies.end();)
+    {
+        if (presentBodies.count(bound->first))
+        {
+            ++bound;
+            continue;
+        }
+        // A destroyed body takes its node with it, a body only removed from the system is still alive and must be hidden
+        std::shared_ptr<ChBody> body = bound->second.lock();
+        if (body)
+        {
+            std::shared_ptr<ChIrrNodeAsset> nodeAsset = GetNodeAsset(*body);
+            if (nodeAsset && nodeAsset->GetIrrlichtNode())
+                nodeAsset->GetIrrlichtNode()->setVisible(false);
+        }
+        bound = BoundBodies.erase(bound);
+    }
+}
+
+bool PreviewRenderer::OnStep()
+{
+    TotalSteps++;
+    StepsSinceFrame++;
+
+    bool due;
+    if (RenderInterval > 0)
+        due = StepsSinceFrame >= RenderInterval;
+    else
+        due = std::chrono::duration<double>(std::chrono::steady_clock::now() - LastFrameTime).count() * FramesPerSecond >= 1.0;
+    if (!due)
+        return true;
+
+    if (!Application.GetDevice()->run())
+        return false;
+    Render();
+    return true;
+}
+
+void PreviewRenderer::Render()
+{
+    Synchronize();
+
+    Application.BeginScene(true, true, irr::video::SColor(255, 140, 161, 192));
+    tools::drawGrid(Application.GetVideoDriver(), 5, 5, 20, 20,
+        ChCoordsys<>(ChVector<>(0, 0.04, 0), Q_from_AngAxis(CH_C_PI / 2, VECT_X)),
+        irr::video::SColor(50, 90, 90, 150), true);
+    Application.DrawAll();
+    Application.EndScene();
+
+    StepsSinceFrame = 0;
+    LastFrameTime = std::chrono::steady_clock::now();
+    TotalFrames++;
+}
+
+void PreviewRenderer::PrintReport(std::ostream& outputStream)
+{
+    outputStream << "Preview : " << TotalFrames << " frames for " << TotalSteps << " steps" << std::endl;
+}
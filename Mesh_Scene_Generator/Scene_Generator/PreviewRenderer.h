@@ -0,0 +1,63 @@
+#pragma once
+#include <map>
+#include <memory>
+#include <chrono>
+#include <ostream>
+#include "chrono/physics/ChSystem.h"
+#include "chrono_irrlicht/ChIrrApp.h"
+
+/// <summary>
+/// Irrlicht preview of a simulation, decoupled from the physics steps.
+/// Only the bodies added since the last synchronisation are converted to Irrlicht meshes, and the removed ones are hidden,
+/// instead of converting every asset again with AssetBindAll/AssetUpdateAll.
+/// A frame is drawn every RenderInterval steps, or at FramesPerSecond on the wall clock, and the simulation is not slowed down to real time.
+/// </summary>
+class PreviewRenderer
+{
+public:
+	/// <summary>
+	/// Build a preview over an application, the bodies already in its system are bound at the first synchronisation
+	/// </summary>
+	/// <param name="application">The Irrlicht application, whose system is previewed</param>
+	/// <param name="renderInterval">A frame is drawn every renderInterval steps, 0 to only use the frame rate</param>
+	/// <param name="framesPerSecond">Wall clock frame rate, used when renderInterval is 0</param>
+	PreviewRenderer(chrono::irrlicht::ChIrrApp& application, int renderInterval = 0, double framesPerSecond = 30.0);
+	/// <summary>
+	/// Bind the bodies added to the system since the last call, and hide the removed ones
+	/// </summary>
+	void Synchronize();
+	/// <summary>
+	/// To be called after each simulation step, draw a frame if one is due
+	/// </summary>
+	/// <returns>False if the window was closed</returns>
+	bool OnStep();
+	/// <summary>
+	/// Synchronize the bodies and draw a frame
+	/// </summary>
+	void Render();
+	/// <summary>
+	/// Number of drawn frames and of simulation steps since the preview creation
+	/// </summary>
+	void PrintReport(std::ostream& outputStream);
+
+public:
+	/// <summary>
+	/// A frame is drawn every RenderInterval steps, 0 to only use the frame rate
+	/// </summary>
+	int RenderInterval;
+	/// <summary>
+	/// Wall clock frame rate, used when RenderInterval is 0
+	/// </summary>
+	double FramesPerSecond;
+
+private:
+	chrono::irrlicht::ChIrrApp& Application;
+	/// <summary>
+	/// Bodies having an Irrlicht node, by address. The weak pointer tells whether the address still holds the same body.
+	/// </summary>
+	std::map<chrono::ChBody*, std::weak_ptr<chrono::ChBody>> BoundBodies;
+	int StepsSinceFrame;
+	std::chrono::steady_clock::time_point LastFrameTime;
+	long long TotalSteps;
+	long long TotalFrames;
+};
@@ -0,0 +1,313 @@
+#include "ResultCache.h"
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <cstring>
+
+namespace fs = std::filesystem;
+
+const char* ResultCache::GeneratorVersion = "3";
+
+
+namespace
+{
+    // 64 bits FNV-1a, chained through the hash argument
+    const uint64_t FnvOffset = 14695981039346656037ull;
+    const uint64_t FnvPrime = 1099511628211ull;
+
+    uint64_t HashBytes(uint64_t hash, const void* data, size_t size)
+    {
+        const unsigned char* bytes = (const unsigned char*)data;
+        for (size_t i = 0; i < size; i++)
+            hash = (hash ^ bytes[i]) * FnvPrime;
+        return hash;
+    }
+
+    template <typename T>
+    uint64_t HashValue(uint64_t hash, const T& value)
+    {
+        return HashBytes(hash, &value, sizeof(value));
+    }
+
+    // The length is hashed too, so that consecutive strings cannot be confused
+    uint64_t HashString(uint64_t hash, const std::string& text)
+    {
+        hash = HashValue(hash, (uint64_t)text.size());
+        return HashBytes(hash, text.data(), text.size());
+    }
+
+    uint64_t HashProbabilities(uint64_t hash, const std::vector<std::tuple<int, std::string>>& probabilities)
+    {
+        hash = HashValue(hash, (uint64_t)probabilities.size());
+        for (auto& probability : probabilities)
+        {
+            hash = HashValue(hash, std::get<0>(probability));
+            hash = HashString(hash, std::get<1>(probability));
+        }
+        return hash;
+    }
+
+    // Every field which changes the draws or the placement of the objects of a category
+    uint64_t HashCategory(uint64_t hash, const std::map<std::string, std::vector<Object>>& objectMap, const std::string& category)
+    {
+        auto objects = objectMap.find(category);
+        if (objects == objectMap.end())
+            return HashValue(hash, (uint64_t)0);
+
+        hash = HashValue(hash, (uint64_t)objects->second.size());
+        for (const Object& object : objects->second)
+        {
+            hash = HashString(hash, object.AssociatedFile);
+            hash = HashString(hash, object.Name);
+            hash = HashString(hash, object.Wnids);
+            hash = HashValue(hash, object.MinVolume);
+            hash = HashValue(hash, object.MaxVolume);
+            hash = HashValue(hash, object.IsLargeObject);
+        }
+        return hash;
+    }
+
+    std::string ToHex(uint64_t value)
+    {
+        std::ostringstream hexStream;
+        hexStream << std::hex << std::setw(16) << std::setfill('0') << value;
+        return hexStream.str();
+    }
+}
+
+
+ResultCache::ResultCache(std::string cacheDirectory, std::string parameters)
+{
+    CacheDirectory = cacheDirectory;
+    Parameters = parameters;
+    Hits = 0;
+    NewScenes = 0;
+    ChangedScenes = 0;
+
+    std::error_code error;
+    fs::create_directories(CacheDirectory, error);
+}
+
+void ResultCache::AddLibrary(std::string name, ObjectLibrary& library)
+{
+    Libraries[name] = &library;
+}
+
+std::string ResultCache::GetSceneKey(unsigned int seed)
+{
+    uint64_t hash = HashString(FnvOffset, GeneratorVersion);
+    hash = HashValue(hash, seed);
+    hash = HashString(hash, Parameters);
+    return ToHex(hash);
+}
+
+uint64_t ResultCache::GetFileChecksum(const std::string& filePath, bool& found)
+{
+    auto memoized = FileChecksums.find(filePath);
+    if (memoized != FileChecksums.end())
+    {
+        found = memoized->second.first;
+        return memoized->second.second;
+    }
+
+    uint64_t hash = ComputeFileChecksum(filePath, found);
+    FileChecksums[filePath] = std::make_pair(found, hash);
+    return hash;
+}
+
+uint64_t ResultCache::ComputeFileChecksum(const std::string& filePath, bool& found)
+{
+    std::ifstream inputStream(filePath, std::ios::binary);
+    found = inputStream.is_open();
+    uint64_t hash = FnvOffset;
+    std::vector<char> buffer(1 << 16);
+    while (inputStream)
+    {
+        inputStream.read(buffer.data(), buffer.size());
+        hash = HashBytes(hash, buffer.data(), (size_t)inputStream.gcount());
+    }
+    return hash;
+}
+
+uint64_t ResultCache::ComputeDependency(const std::string& dependency, bool& found)
+{
+    found = false;
+    std::istringstream dependencyStream(dependency);
+    std::string type, libraryName;
+    dependencyStream >> type;
+
+    if (type == "mesh")
+        return GetFileChecksum(dependency.substr(type.size() + 1), found);
+
+    dependencyStream >> libraryName;
+    auto library = Libraries.find(libraryName);
+    if (library == Libraries.end())
+        return 0;
+
+    if (type == "probabilities")
+    {
+        found = true;
+        uint64_t hash = HashProbabilities(FnvOffset, library->second->LargeObjectProbability);
+        return HashProbabilities(hash, library->second->SmallObjectProbability);
+    }
+    if (type == "category")
+    {
+        std::string category;
+        dependencyStream.ignore(1);
+        std::getline(dependencyStream, category);
+        found = library->second->LargeObjects.count(category) || library->second->SmallObjects.count(category);
+        uint64_t hash = HashCategory(FnvOffset, library->second->LargeObjects, category);
+        return HashCategory(hash, library->second->SmallObjects, category);
+    }
+    return 0;
+}
+
+bool ResultCache::Restore(unsigned int seed, std::string outputPath)
+{
+    fs::path entryDirectory = fs::path(CacheDirectory) / GetSceneKey(seed);
+    std::ifstream manifestStream(entryDirectory / "manifest.txt");
+    std::string line, version, storedSeed, parameters;
+    // The header guards against key collisions
+    if (!std::getline(manifestStream, version) || !std::getline(manifestStream, storedSeed) || !std::getline(manifestStream, parameters)
+        || version != GeneratorVersion || storedSeed != std::to_string(seed) || parameters != Parameters)
+    {
+        NewScenes++;
+        return false;
+    }
+
+    std::vector<std::pair<std::string, std::string>> outputs;
+    bool changed = false;
+    while (std::getline(manifestStream, line))
+    {
+        std::istringstream lineStream(line);
+        std::string type, value;
+        lineStream >> type >> value;
+        lineStream.ignore(1);
+        std::string name;
+        std::getline(lineStream, name);
+
+        if (type == "dependency")
+        {
+            bool found;
+            uint64_t checksum = ComputeDependency(name, found);
+            if (!found || ToHex(checksum) != value)
+            {
+                ChangedDependencies[name]++;
+                changed = true;
+            }
+        }
+        else if (type == "output")
+            outputs.push_back(std::make_pair(value, name));
+    }
+    if (changed)
+    {
+        ChangedScenes++;
+        return false;
+    }
+
+    std::error_code error;
+    for (auto& output : outputs)
+    {
+        fs::copy_file(entryDirectory / output.first, outputPath + output.second, fs::copy_options::overwrite_existing, error);
+        if (error)
+        {
+            NewScenes++;
+            return false;
+        }
+    }
+    Hits++;
+    return true;
+}
+
+bool ResultCache::Store(unsigned int seed, std::string outputPath, const std::vector<std::string>& outputSuffixes)
+{
+    std::vector<std::string> dependencies;
+    std::set<std::string> files;
+    for (auto& library : Libraries)
+    {
+        dependencies.push_back("probabilities " + library.first);
+        for (auto& category : library.second->DrawnCategories)
+            dependencies.push_back("category " + library.first + " " + category);
+        files.insert(library.second->DrawnFiles.begin(), library.second->DrawnFiles.end());
+    }
+    for (auto& file : files)
+        dependencies.push_back("mesh " + file);
+
+    std::string sceneKey = GetSceneKey(seed);
+    std::ostringstream manifest;
+    manifest << GeneratorVersion << "\n" << seed << "\n" << Parameters << "\n";
+    uint64_t contentKey = HashString(FnvOffset, sceneKey);
+    for (auto& dependency : dependencies)
+    {
+        bool found;
+        uint64_t checksum = ComputeDependency(dependency, found);
+        if (!found)
+            return false;
+        manifest << "dependency " << ToHex(checksum) << " " << dependency << "\n";
+        contentKey = HashValue(HashString(contentKey, dependency), checksum);
+    }
+
+    // Outputs are named after the content key, so that an entry being replaced stays whole until its manifest is
+    fs::path entryDirectory = fs::path(CacheDirectory) / sceneKey;
+    std::string tag = ToHex(contentKey);
+    std::error_code error;
+    fs::create_directories(entryDirectory, error);
+    for (size_t i = 0; i < outputSuffixes.size(); i++)
+    {
+        std::string fileName = "output" + std::to_string(i) + "." + tag;
+        fs::copy_file(outputPath + outputSuffixes[i], entryDirectory / fileName, fs::copy_options::overwrite_existing, error);
+        if (error)
+            return false;
+        manifest << "output " << fileName << " " << outputSuffixes[i] << "\n";
+    }
+
+    fs::path temporaryPath = entryDirectory / ("manifest.tmp." + tag);
+    {
+        std::ofstream manifestStream(temporaryPath);
+        manifestStream << manifest.str();
+        if (!manifestStream.good())
+            return false;
+    }
+    fs::rename(temporaryPath, entryDirectory / "manifest.txt", error);
+    if (error)
+    {
+        fs::remove(temporaryPath, error);
+        return false;
+    }
+
+    // Outputs of a previous version of the entry
+    std::vector<fs::path> staleFiles;
+    for (fs::directory_iterator entry(entryDirectory, error), end; !error && entry != end; entry.increment(error))
+    {
+        std::string name = entry->path().filename().string();
+        if (name.compare(0, 6, "output") == 0 && entry->path().extension().string() != "." + tag)
+            staleFiles.push_back(entry->path());
+    }
+    for (auto& staleFile : staleFiles)
+        fs::remove(staleFile, error);
+    return true;
+}
+
+uint64_t ResultCache::ComputeLibraryChecksum(ObjectLibrary& library)
+{
+    uint64_t hash = HashProbabilities(FnvOffset, library.LargeObjectProbability);
+    hash = HashProbabilities(hash, library.SmallObjectProbability);
+    for (auto& category : library.LargeObjects)
+        hash = HashCategory(HashString(hash, category.first), library.LargeObjects, category.first);
+    for (auto& category : library.SmallObjects)
+        hash = HashCategory(HashString(hash, category.first), library.SmallObjects, category.first);
+    return hash;
+}
+
+void ResultCache::PrintReport(std::ostream& outputStream)
+{
+    int total = Hits + NewScenes + ChangedScenes;
+    outputStream << "Result cache " << CacheDirectory << " : " << Hits << "/" << total << " scenes reused";
+    if (total > 0)
+        outputStream << " (" << 100.0 * Hits / total << " %)";
+    outputStream << std::endl;
+    outputStream << "  new : " << NewScenes << ", invalidated : " << ChangedScenes << std::endl;
+    for (auto& dependency : ChangedDependencies)
+        outputStream << "  changed " << dependency.first << " : " << dependency.second << " scenes" << std::endl;
+}
@@ -0,0 +1,92 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <map>
+#include <ostream>
+#include <cstdint>
+#include "ObjectLibrary.h"
+
+/// <summary>
+/// Cache of generated scenes, so that regenerating a dataset after a change of the libraries only recomputes the affected scenes.
+/// A scene is identified by its seed and the generation parameters. Its entry records the library entries it depended on :
+/// the probability vectors of each library, the description of every drawn category and the checksum of every drawn mesh.
+/// The outputs are reused while all these dependencies are unchanged, since the generation would then take exactly the same path.
+/// The directory holds, for each scene, [scene key]/manifest.txt and the outputs, and can be shared between workers.
+/// </summary>
+class ResultCache
+{
+public:
+	/// <summary>
+	/// Build a cache over a directory
+	/// </summary>
+	/// <param name="cacheDirectory">Directory of the cache, created if needed</param>
+	/// <param name="parameters">Every generation setting which changes the outputs, in any textual form</param>
+	ResultCache(std::string cacheDirectory, std::string parameters);
+	/// <summary>
+	/// Declare a library the scenes can draw from
+	/// </summary>
+	/// <param name="name">Name of the library in the manifests, stable between runs</param>
+	/// <param name="library">The library, whose draw history is used to know the dependencies of a scene</param>
+	void AddLibrary(std::string name, ObjectLibrary& library);
+	/// <summary>
+	/// Copy the cached outputs of a scene, if the scene was already generated and none of its dependencies changed
+	/// </summary>
+	/// <param name="seed">Seed of the scene</param>
+	/// <param name="outputPath">Prefix of the output files</param>
+	/// <returns>False if the scene has to be generated</returns>
+	bool Restore(unsigned int seed, std::string outputPath);
+	/// <summary>
+	/// Store the outputs of a generated scene, with the dependencies drawn since the draw history of the libraries was cleared
+	/// </summary>
+	/// <param name="seed">Seed of the scene</param>
+	/// <param name="outputPath">Prefix of the output files</param>
+	/// <param name="outputSuffixes">Suffixes of the output files, appended to outputPath</param>
+	/// <returns>False if the outputs could not be stored</returns>
+	bool Store(unsigned int seed, std::string outputPath, const std::vector<std::string>& outputSuffixes);
+	/// <summary>
+	/// Write the hit rate of the cache and the reasons of the misses
+	/// </summary>
+	void PrintReport(std::ostream& outputStream);
+	/// <summary>
+	/// Checksum of the probabilities and of every entry of a library, the content of the meshes excluded
+	/// </summary>
+	static uint64_t ComputeLibraryChecksum(ObjectLibrary& library);
+	/// <summary>
+	/// Checksum of the content of a file
+	/// </summary>
+	/// <param name="found">False if the file could not be read</param>
+	static uint64_t ComputeFileChecksum(const std::string& filePath, bool& found);
+
+public:
+	/// <summary>
+	/// Version of the generation code, to be changed when a code change alters the outputs so that every entry is invalidated
+	/// </summary>
+	static const char* GeneratorVersion;
+
+private:
+	/// <summary>
+	/// Key of a scene, from the seed and the parameters
+	/// </summary>
+	std::string GetSceneKey(unsigned int seed);
+	/// <summary>
+	/// Current checksum of a dependency, named as in the manifests ("probabilities [library]", "category [library] [name]" or "mesh [file]")
+	/// </summary>
+	/// <param name="found">False if the dependency no longer exists</param>
+	uint64_t ComputeDependency(const std::string& dependency, bool& found);
+	/// <summary>
+	/// ComputeFileChecksum, memoized by path for the run
+	/// </summary>
+	uint64_t GetFileChecksum(const std::string& filePath, bool& found);
+
+	std::string CacheDirectory;
+	std::string Parameters;
+	std::map<std::string, ObjectLibrary*> Libraries;
+	std::map<std::string, std::pair<bool, uint64_t>> FileChecksums;
+	int Hits;
+	int NewScenes;
+	int ChangedScenes;
+	/// <summary>
+	/// Number of invalidated scenes by changed dependency
+	/// </summary>
+	std::map<std::string, int> ChangedDependencies;
+};
@@ -6,14 +6,61 @@
 #include "chrono/assets/ChTriangleMeshShape.h"
 #include "chrono/physics/ChBodyEasy.h"
 #include "chrono/assets/ChBoxShape.h"
+#include <thread>
+#include <algorithm>
+#include "ParallelFor.h"
+#include "Log.h"
 
 
+namespace
+{
+    // The draws of a placement used to be the arguments of a single call, whose evaluation order is unspecified.
+    // They are sequenced as MSVC evaluated them (right to left), so that the scenes of a seed are unchanged.
+    chrono::Vector drawPosition(std::default_random_engine& randomEngine, std::uniform_real_distribution<double>& randomPositionX,
+        std::uniform_real_distribution<double>& randomPositionY, std::uniform_real_distribution<double>& randomPositionZ)
+    {
+        double z = randomPositionZ(randomEngine);
+        double y = randomPositionY(randomEngine);
+        double x = randomPositionX(randomEngine);
+        return chrono::Vector(x, y, z);
+    }
+
+    // The yaw first, then the engine state the scale is drawn from, then the object
+    PreparedObject drawObject(ObjectLibrary& library, bool largeObject, std::default_random_engine& randomEngine, std::uniform_real_distribution<double>& randomAngleGiver,
+        chrono::Vector position, double mass, bool restOnPosition)
+    {
+        PreparedObject object;
+        object.RotationAngle = randomAngleGiver(randomEngine);
+        object.ScaleEngine = randomEngine;
+        object.BaseObject = library.GiveRandomObject(randomEngine, largeObject);
+        object.Position = position;
+        object.Mass = mass;
+        object.RestOnPosition = restOnPosition;
+        return object;
+    }
+}
+
+MeshWelder Scene::MeshLoader;
+bool Scene::Headless = false;
+size_t Scene::HeadlessCachedVertices = 0;
+int Scene::NumberOfThreads = std::max(1, (int)std::thread::hardware_concurrency());
+LayoutProxyBuilder Scene::LayoutProxies;
+bool Scene::UseLayoutProxy = false;
+
 Scene::Scene()
 {
 
 }
 
-void Scene::AddLayout(chrono::ChSystemNSC& mphysicalSystem, ObjectLibrary layoutLibrary, std::default_random_engine& randomEngine, bool addToSystem)
+void Scene::AddLayout(chrono::ChSystemNSC& mphysicalSystem, ObjectLibrary& layoutLibrary, std::default_random_engine& randomEngine, bool addToSystem)
+{
+    // For testing purposes, this is a good layout
+    // Object fixedLayout(std::string("scene"), std::string(layoutLibrary.LibraryRoot + "office9_layout.obj"), std::string("000"), 1.0, 1.0, true);
+    // SetLayout(mphysicalSystem, fixedLayout, addToSystem);
+    SetLayout(mphysicalSystem, layoutLibrary.GiveRandomObject(randomEngine, true), addToSystem);
+}
+
+void Scene::SetLayout(chrono::ChSystemNSC& mphysicalSystem, Object layout, bool addToSystem)
 {
     auto mat = chrono_types::make_shared<chrono::ChMaterialSurfaceNSC>();
     mat->SetFriction(0.4f);
@@ -21,43 +68,64 @@ void Scene::AddLayout(chrono::ChSystemNSC& mphysicalSystem, ObjectLibrary layout
     mat->SetComplianceT(0.0);
     mat->SetDampingF(1.0f);
 
-    
-
-    UsedLayout = layoutLibrary.GiveRandomObject(randomEngine, true);
+    UsedLayout = layout;
 
-    // For testing purposes, this is a good layout
-    // Object fixedLayout(std::string("scene"), std::string(layoutLibrary.LibraryRoot + "office9_layout.obj"), std::string("000"), 1.0, 1.0, true);
-    // UsedLayout = fixedLayout;
-    SceneLayout = AddObject(mphysicalSystem, UsedLayout, mat, randomEngine, chrono::Vector(0, 0, 0), 0.0, false, 10.0, true, addToSystem);
+    // The layout is fixed, so its scale is not drawn and the random engine is not used
+    std::default_random_engine unusedEngine;
+    if (!UseLayoutProxy)
+    {
+        SceneLayout = AddObject(mphysicalSystem, UsedLayout, mat, unusedEngine, chrono::Vector(0, 0, 0), 0.0, false, 10.0, true, addToSystem);
+        SceneLayout->GetTotalAABB(SceneBoundingBoxMin, SceneBoundingBoxMax);
+        ReleaseSourceMeshes();
+        return;
+    }
 
-    SceneLayout->GetTotalAABB(SceneBoundingBoxMin, SceneBoundingBoxMax);
+    // The collision model of the full mesh is never built, the body directly gets the proxy
+    PreparedObject prepared;
+    prepared.BaseObject = UsedLayout;
+    prepared.ScaleEngine = unusedEngine;
+    prepared.Position = chrono::Vector(0, 0, 0);
+    prepared.Mass = 10.0;
+    prepared.Fixed = true;
+    PrepareObject(prepared, mat);
+    prepared.Body = chrono_types::make_shared<chrono::ChBody>();
+    BuildMeshCollision(prepared.Body, prepared.Mesh, mat, prepared.Mass, prepared.Fixed, LayoutProxies.GetProxy(UsedLayout.AssociatedFile, *prepared.Mesh).get());
+    SceneLayout = PlacePreparedObject(mphysicalSystem, prepared, addToSystem);
+
+    // The proxy boxes stand behind the surfaces, the scene bounds are the ones of the mesh
+    double xmin, xmax, ymin, ymax, zmin, zmax;
+    UsedLayout.ComputeMeshBounds(prepared.Mesh, xmin, xmax, ymin, ymax, zmin, zmax);
+    SceneBoundingBoxMin = prepared.Position + chrono::Vector(xmin, ymin, zmin);
+    SceneBoundingBoxMax = prepared.Position + chrono::Vector(xmax, ymax, zmax);
+    ReleaseSourceMeshes();
 }
 
-void Scene::AddLargeObjects(chrono::ChSystemNSC& mphysicalSystem, ObjectLibrary library, std::default_random_engine& randomEngine, int maxNumberOfLargeObject)
+void Scene::AddLargeObjects(chrono::ChSystemNSC& mphysicalSystem, ObjectLibrary& library, std::default_random_engine& randomEngine, int maxNumberOfLargeObject)
 {
     // TODO : check if useful to keep it here or keep a constant object
     // Generate the common material for the scene object
-    auto mat = chrono_types::make_shared<chrono::ChMaterialSurfaceNSC>();
-    mat->SetFriction(0.5f);
-    mat->SetRollingFriction(0.5f);
-    mat->SetSpinningFriction(0.5f);
-    mat->SetCompliance(0.0);
-    mat->SetComplianceT(0.0);
-    mat->SetDampingF(1.0f);
+    auto mat = CreateObjectMaterial(true);
 
     std::uniform_real_distribution<double> randomPositionX(SceneBoundingBoxMin[0] + 0.1, SceneBoundingBoxMax[0] - 0.1);
     std::uniform_real_distribution<double> randomPositionY(SceneBoundingBoxMin[1] + 0.1, SceneBoundingBoxMax[1] - 0.1);
     std::uniform_real_distribution<double> randomPositionZ(SceneBoundingBoxMin[2] + 0.1, SceneBoundingBoxMax[2] - 0.1);
-    bool useConvex = false;
 
     std::uniform_int_distribution<int> randomNumberOfLargeObject(std::min(5, maxNumberOfLargeObject), maxNumberOfLargeObject);
     std::uniform_real_distribution<double> randomAngleGiver(-M_PI, M_PI);
 
     int numberOfLargeObjects = randomNumberOfLargeObject(randomEngine);
+    // Every object is drawn first, then the objects are built in parallel and added to the engine in the drawing order
+    std::vector<PreparedObject> objects;
     for (int i = 0; i < numberOfLargeObjects; i++)
     {
-        chrono::Vector position(randomPositionX(randomEngine), randomPositionY(randomEngine), randomPositionZ(randomEngine));
-        std::shared_ptr<chrono::ChBody> addedObject = AddObject(mphysicalSystem, library.GiveRandomObject(randomEngine, true), mat, randomEngine, position, randomAngleGiver(randomEngine), useConvex, 1000.0);
+        chrono::Vector position = drawPosition(randomEngine, randomPositionX, randomPositionY, randomPositionZ);
+        objects.push_back(drawObject(library, true, randomEngine, randomAngleGiver, position, 1000.0, false));
+    }
+    PrepareObjects(objects, mat);
+
+    for (auto& object : objects)
+    {
+        std::shared_ptr<chrono::ChBody> addedObject = PlacePreparedObject(mphysicalSystem, object, true);
         chrono::Vector minBound;
         chrono::Vector maxBound; 
         addedObject->GetTotalAABB(minBound, maxBound);
@@ -65,19 +133,11 @@ void Scene::AddLargeObjects(chrono::ChSystemNSC& mphysicalSystem, ObjectLibrary
     }
 }
 
-void Scene::AddSmallObjects(chrono::ChSystemNSC& mphysicalSystem, ObjectLibrary library, std::default_random_engine& randomEngine, int maxNumberOfSmallObject, bool placeOnLargeObject)
+void Scene::AddSmallObjects(chrono::ChSystemNSC& mphysicalSystem, ObjectLibrary& library, std::default_random_engine& randomEngine, int maxNumberOfSmallObject, bool placeOnLargeObject)
 {
     // TODO : check if useful to keep it here or keep a constant object
     // Generate the common material for the scene object
-    auto mat = chrono_types::make_shared<chrono::ChMaterialSurfaceNSC>();
-    mat->SetFriction(0.8f);
-    mat->SetRollingFriction(0.9f);
-    mat->SetSpinningFriction(0.9f);
-    mat->SetCompliance(0.0);
-    mat->SetComplianceT(0.0);
-    mat->SetDampingF(1.0f);
-
-    bool useConvex = false;
+    auto mat = CreateObjectMaterial(false);
     
     double xmin = SceneBoundingBoxMin[0] + 0.3;
     double xmax = SceneBoundingBoxMax[0] - 0.3;
@@ -94,8 +154,21 @@ void Scene::AddSmallObjects(chrono::ChSystemNSC& mphysicalSystem, ObjectLibrary
     std::uniform_real_distribution<double> randomAngleGiver(-M_PI, M_PI);
     std::uniform_int_distribution<int> randomNumberOfSmallObject(std::min(5, maxNumberOfSmallObject), maxNumberOfSmallObject);
     int numberOfSmallObjects = randomNumberOfSmallObject(randomEngine);
+    // Every object is drawn first, then the objects are built in parallel and added to the engine in the drawing order
+    std::vector<PreparedObject> objects;
     for (int i = 0; i < numberOfSmallObjects; i++)
     {
+        if (placeOnLargeObject && SupportSurfaces.Size() > 0)
+        {
+            chrono::Vector position;
+            if (SupportSurfaces.SamplePoint(randomEngine, 0.15, position))
+            {
+                // Small gap so the object does not start in contact with its support
+                position[1] += 0.01;
+                objects.push_back(drawObject(library, false, randomEngine, randomAngleGiver, position, 10.0, true));
+                continue;
+            }
+        }
         if (placeOnLargeObject)
         {
             std::tuple<chrono::Vector, chrono::Vector> bound = LargeObjectsBoundaries[i % LargeObjectsBoundaries.size()];
@@ -103,11 +176,48 @@ void Scene::AddSmallObjects(chrono::ChSystemNSC& mphysicalSystem, ObjectLibrary
             randomPositionY = std::uniform_real_distribution<double>(std::max(std::get<0>(bound)[1], ymin), std::min(std::get<1>(bound)[1], ymax));
             randomPositionZ = std::uniform_real_distribution<double>(std::max(std::get<0>(bound)[2], zmin), std::min(std::get<1>(bound)[2], zmax));
         }
-        chrono::Vector position(randomPositionX(randomEngine), randomPositionY(randomEngine), randomPositionZ(randomEngine));
-        AddObject(mphysicalSystem, library.GiveRandomObject(randomEngine, false), mat, randomEngine, position, randomAngleGiver(randomEngine), useConvex, 10.0);
+        chrono::Vector position = drawPosition(randomEngine, randomPositionX, randomPositionY, randomPositionZ);
+        objects.push_back(drawObject(library, false, randomEngine, randomAngleGiver, position, 10.0, false));
+    }
+    PrepareObjects(objects, mat);
+
+    for (auto& object : objects)
+        PlacePreparedObject(mphysicalSystem, object, true);
+}
+
+std::shared_ptr<chrono::ChMaterialSurfaceNSC> Scene::CreateObjectMaterial(bool largeObject)
+{
+    auto mat = chrono_types::make_shared<chrono::ChMaterialSurfaceNSC>();
+    if (largeObject)
+    {
+        mat->SetFriction(0.5f);
+        mat->SetRollingFriction(0.5f);
+        mat->SetSpinningFriction(0.5f);
     }
+    else
+    {
+        mat->SetFriction(0.8f);
+        mat->SetRollingFriction(0.9f);
+        mat->SetSpinningFriction(0.9f);
+    }
+    mat->SetCompliance(0.0);
+    mat->SetComplianceT(0.0);
+    mat->SetDampingF(1.0f);
+    return mat;
 }
 
+int Scene::ExtractSupportSurfaces(double maxTiltAngle, double minHeight)
+{
+    SupportSurfaces.Clear();
+    for (auto& object : MovingObjects)
+    {
+        if (!object.BaseObject.IsLargeObject || !object.Mesh)
+            continue;
+        SupportSurfaces.AddMesh(object.Mesh, object.CollisionBody, std::cos(maxTiltAngle), SceneBoundingBoxMin[1] + minHeight);
+    }
+    Log::Out() << "Support surfaces : " << SupportSurfaces.Size() << " patches, " << SupportSurfaces.GetTotalArea() << " m2" << std::endl;
+    return (int)SupportSurfaces.Size();
+}
 
 void Scene::AddGround(chrono::ChSystemNSC& mphysicalSystem)
 {
@@ -123,7 +233,7 @@ void Scene::AddGround(chrono::ChSystemNSC& mphysicalSystem)
 
     auto mrigidFloor = chrono_types::make_shared <chrono::ChBodyEasyBox> (250, 4, 250,  // x,y,z size
         1000,         // density
-        true,         // visualization?
+        !Headless,    // visualization?
         true,         // collision?
         mat);         // contact material
     mrigidFloor->SetPos(chrono::ChVector<>(0, -2, 0));
@@ -133,21 +243,50 @@ void Scene::AddGround(chrono::ChSystemNSC& mphysicalSystem)
 }
 
 std::shared_ptr<chrono::ChBody> Scene::AddObject(chrono::ChSystemNSC& mphysicalSystem, Object object, std::shared_ptr<chrono::ChMaterialSurfaceNSC>& commonMaterial,
-    std::default_random_engine randomEngine, chrono::Vector position, double rotationAngle, bool useConvexHull, double mass, bool fixed, bool addToSystem)
+    std::default_random_engine randomEngine, chrono::Vector position, double rotationAngle, bool useConvexHull, double mass, bool fixed, bool addToSystem, bool restOnPosition)
 {
-    auto mesh = chrono_types::make_shared<chrono::geometry::ChTriangleMeshConnected>();
+    PreparedObject prepared;
+    prepared.BaseObject = object;
+    prepared.ScaleEngine = randomEngine;
+    prepared.Position = position;
+    prepared.RotationAngle = rotationAngle;
+    prepared.Mass = mass;
+    prepared.Fixed = fixed;
+    prepared.RestOnPosition = restOnPosition;
+    if (!useConvexHull)
+        prepared.Body = chrono_types::make_shared<chrono::ChBody>();
+    PrepareObject(prepared, commonMaterial);
+
+    if (useConvexHull)
+    {     
+        auto convexHull = chrono_types::make_shared< chrono::ChBodyEasyConvexHull>(prepared.Mesh->getCoordsVertices(), mass, !Headless, true, commonMaterial);
+        convexHull->SetBodyFixed(fixed);
+        convexHull->SetShowCollisionMesh(true);
+        prepared.Body = convexHull;
+
+        // TODO only a convex hull doesn't seem to work
+        //collisionObject->GetCollisionModel()->ClearModel();
+        //std::vector<chrono::Vector> vertices = mesh->getCoordsVertices();
+        //collisionObject->GetCollisionModel()->AddConvexHull(commonMaterial, vertices, chrono::VNULL, chrono::ChMatrix33<>(1));
+    }
 
-    mesh->LoadWavefrontMesh(object.AssociatedFile);
+    return PlacePreparedObject(mphysicalSystem, prepared, addToSystem);
+}
 
+void Scene::PrepareObject(PreparedObject& object, std::shared_ptr<chrono::ChMaterialSurfaceNSC> material, int weldThreads)
+{
+    object.Mesh = LoadMesh(object.BaseObject, weldThreads);
 
-    double scale = fixed ? 1.0 : object.ComputeWantedScale(randomEngine, mesh);
-    mesh->Transform(chrono::Vector(0.0, 0.0, 0.0), chrono::ChMatrix33<>(scale));
-    std::cout << mesh->RepairDuplicateVertexes(1e-3) << std::endl;
+    object.Scale = object.Fixed ? 1.0 : object.BaseObject.ComputeWantedScale(object.ScaleEngine, object.Mesh);
+    ScaleMesh(object.Mesh, object.Scale);
 
     // We correct position corresponding to the object dimension
     // Note that if the object is too big, the correction will not work and the object will disappear at a "bad contact check".
+    chrono::Vector& position = object.Position;
     double xmin, xmax, ymin, ymax, zmin, zmax;
-    object.ComputeMeshBounds(mesh, xmin, xmax, ymin, ymax, zmin, zmax);
+    object.BaseObject.ComputeMeshBounds(object.Mesh, xmin, xmax, ymin, ymax, zmin, zmax);
+    if (object.RestOnPosition)
+        position[1] -= ymin;
     if (position[0] - xmin < SceneBoundingBoxMin[0])
         position[0] += xmin - position[0] + 0.001;
     else if (position[0] + xmax > SceneBoundingBoxMax[0])
@@ -160,67 +299,118 @@ std::shared_ptr<chrono::ChBody> Scene::AddObject(chrono::ChSystemNSC& mphysicalS
     else if (position[2] + zmax > SceneBoundingBoxMax[2])
         position[2] -= zmax - position[2] + 0.001;
 
-    if (useConvexHull)
-    {     
-        auto convexHull = chrono_types::make_shared< chrono::ChBodyEasyConvexHull>(mesh->getCoordsVertices(), mass, true, true, commonMaterial);
-        convexHull->SetBodyFixed(fixed);
-        convexHull->SetPos(position);
-        if (rotationAngle != 0.0)
-            convexHull->SetRot(chrono::ChMatrix33<>(
-                chrono::Vector(std::cos(rotationAngle), 0.0, -std::sin(rotationAngle)),
-                chrono::Vector(0.0, 1.0, 0.0),
-                chrono::Vector(std::sin(rotationAngle), 0.0, std::cos(rotationAngle))));
-        convexHull->SetShowCollisionMesh(true);
+    if (object.Body)
+        BuildMeshCollision(object.Body, object.Mesh, material, object.Mass, object.Fixed);
+}
 
-        if (addToSystem)
-            mphysicalSystem.Add(convexHull);
+void Scene::PrepareObjects(std::vector<PreparedObject>& objects, std::shared_ptr<chrono::ChMaterialSurfaceNSC> material)
+{
+    // The bodies are created in the drawing order, so that their identifiers do not depend on the threads scheduling
+    for (auto& object : objects)
+        object.Body = chrono_types::make_shared<chrono::ChBody>();
 
-        if (!fixed)
-            MovingObjects.push_back(PlacedObject(object, scale, convexHull));
+    // Each object task already holds a thread, the welding of an uncached mesh only gets its share of the remaining ones
+    int objectThreads = (int)std::min<size_t>(std::max(1, NumberOfThreads), std::max<size_t>(1, objects.size()));
+    int weldThreads = std::max(1, NumberOfThreads / objectThreads);
 
+    // Meshes are shared through the MeshLoader cache, which is thread safe, and each task only writes its own object
+    ParallelFor(objects.size(), NumberOfThreads, [&](size_t i)
+    {
+        PrepareObject(objects[i], material, weldThreads);
+    });
+    ReleaseSourceMeshes();
+}
 
-        return convexHull;
+void Scene::ReleaseSourceMeshes()
+{
+    // Each body keeps its own scaled copy alive through its collision model, the cached meshes are only needed by the next loads
+    if (Headless)
+        MeshLoader.TrimCache(HeadlessCachedVertices);
+}
 
-        // TODO only a convex hull doesn't seem to work
-        //collisionObject->GetCollisionModel()->ClearModel();
-        //std::vector<chrono::Vector> vertices = mesh->getCoordsVertices();
-        //collisionObject->GetCollisionModel()->AddConvexHull(commonMaterial, vertices, chrono::VNULL, chrono::ChMatrix33<>(1));
-    }
+std::shared_ptr<chrono::ChBody> Scene::PlacePreparedObject(chrono::ChSystemNSC& mphysicalSystem, PreparedObject& object, bool addToSystem)
+{
+    std::shared_ptr<chrono::ChBody> body = object.Body;
+    body->SetPos(object.Position);
+    if (object.RotationAngle != 0.0)
+        body->SetRot(chrono::ChMatrix33<>(
+            chrono::Vector(std::cos(object.RotationAngle), 0.0, -std::sin(object.RotationAngle)),
+            chrono::Vector(0.0, 1.0, 0.0),
+            chrono::Vector(std::sin(object.RotationAngle), 0.0, std::cos(object.RotationAngle))));
+
+    if (addToSystem)
+        mphysicalSystem.Add(body);
+
+    if (!object.Fixed)
+        MovingObjects.push_back(PlacedObject(object.BaseObject, object.Scale, body, object.Mesh));
     else
-    {
-        auto collisionObject = chrono_types::make_shared<chrono::ChBody>();
-
-        collisionObject->SetPos(position);
-        if (rotationAngle != 0.0)
-            collisionObject->SetRot(chrono::ChMatrix33<>(
-                chrono::Vector(std::cos(rotationAngle), 0.0, -std::sin(rotationAngle)),
-                chrono::Vector(0.0, 1.0, 0.0),
-                chrono::Vector(std::sin(rotationAngle), 0.0, std::cos(rotationAngle))));
-        collisionObject->SetMass(mass);
-        collisionObject->SetBodyFixed(fixed);
-        collisionObject->SetCollide(true);
+        LayoutMesh = object.Mesh;
 
+    return body;
+}
+
+std::shared_ptr<chrono::ChBody> Scene::RestoreObject(chrono::ChSystemNSC& mphysicalSystem, Object object, double scale, double mass)
+{
+    auto mesh = LoadMesh(object);
+    ScaleMesh(mesh, scale);
+
+    auto collisionObject = BuildMeshBody(mesh, CreateObjectMaterial(object.IsLargeObject), mass, false);
+    mphysicalSystem.Add(collisionObject);
+    MovingObjects.push_back(PlacedObject(object, scale, collisionObject, mesh));
+
+    return collisionObject;
+}
+
+std::shared_ptr<chrono::geometry::ChTriangleMeshConnected> Scene::LoadMesh(Object& object, int weldThreads)
+{
+    // The collision model and the visualization asset both keep a reference to the mesh, so each instance gets its own copy
+    return MeshLoader.LoadMesh(object.AssociatedFile, weldThreads);
+}
+
+void Scene::ScaleMesh(std::shared_ptr<chrono::geometry::ChTriangleMeshConnected> mesh, double scale)
+{
+    if (scale != 1.0)
+        mesh->Transform(chrono::Vector(0.0, 0.0, 0.0), chrono::ChMatrix33<>(scale));
+}
+
+std::shared_ptr<chrono::ChBody> Scene::BuildMeshBody(std::shared_ptr<chrono::geometry::ChTriangleMeshConnected> mesh, std::shared_ptr<chrono::ChMaterialSurfaceNSC> material, double mass, bool fixed)
+{
+    auto collisionObject = chrono_types::make_shared<chrono::ChBody>();
+    BuildMeshCollision(collisionObject, mesh, material, mass, fixed);
+    return collisionObject;
+}
+
+void Scene::BuildMeshCollision(std::shared_ptr<chrono::ChBody> collisionObject, std::shared_ptr<chrono::geometry::ChTriangleMeshConnected> mesh,
+    std::shared_ptr<chrono::ChMaterialSurfaceNSC> material, double mass, bool fixed, const LayoutProxy* proxy)
+{
+    collisionObject->SetMass(mass);
+    collisionObject->SetBodyFixed(fixed);
+    collisionObject->SetCollide(true);
+
+    if (proxy)
+        proxy->BuildCollisionModel(*collisionObject, material);
+    else
+    {
         collisionObject->GetCollisionModel()->ClearModel();
-        collisionObject->GetCollisionModel()->AddTriangleMesh(commonMaterial, mesh, false, false, chrono::VNULL, chrono::ChMatrix33<>(1), 0.005);
+        collisionObject->GetCollisionModel()->AddTriangleMesh(material, mesh, false, false, chrono::VNULL, chrono::ChMatrix33<>(1), 0.005);
         collisionObject->GetCollisionModel()->BuildModel();
+    }
 
+    if (!Headless)
+    {
         auto mesh_asset = chrono_types::make_shared<chrono::ChTriangleMeshShape>();
         mesh_asset->SetMesh(mesh);
         mesh_asset->SetBackfaceCull(true);
         collisionObject->AddAsset(mesh_asset);
-        collisionObject->SetUseSleeping(true);
-
-        if (addToSystem)
-            mphysicalSystem.Add(collisionObject);
-
-        if (!fixed)
-            MovingObjects.push_back(PlacedObject(object, scale, collisionObject));
-
-        return collisionObject;
     }
-
+    collisionObject->SetUseSleeping(true);
 }
 
+void Scene::RemoveMovingObject(chrono::ChSystem& mphysicalSystem, int index)
+{
+    mphysicalSystem.RemoveBody(MovingObjects[index].CollisionBody);
+    MovingObjects.erase(MovingObjects.begin() + index);
+}
 
 double Scene::GetSceneArea()
 {
@@ -1,6 +1,50 @@
 #pragma once
 #include "ObjectLibrary.h"
 #include "PlacedObject.h"
+#include "SupportSurfaceIndex.h"
+#include "MeshWelder.h"
+#include "LayoutProxy.h"
+
+/// <summary>
+/// Object whose choices are drawn, and whose mesh and collision model are then built apart from the engine
+/// </summary>
+struct PreparedObject
+{
+	/// <summary>
+	/// Object definition
+	/// </summary>
+	Object BaseObject;
+	/// <summary>
+	/// State of the random engine the scale is drawn from
+	/// </summary>
+	std::default_random_engine ScaleEngine;
+	/// <summary>
+	/// Wanted position, corrected by the preparation to fit the object in the scene
+	/// </summary>
+	chrono::Vector Position;
+	/// <summary>
+	/// Yaw (rad) of the object
+	/// </summary>
+	double RotationAngle = 0.0;
+	double Mass = 10.0;
+	bool Fixed = false;
+	/// <summary>
+	/// If true, the object is lifted so that its lowest point lies on Position
+	/// </summary>
+	bool RestOnPosition = false;
+	/// <summary>
+	/// Scale of the object, set by the preparation
+	/// </summary>
+	double Scale = 1.0;
+	/// <summary>
+	/// Scaled mesh, set by the preparation
+	/// </summary>
+	std::shared_ptr<chrono::geometry::ChTriangleMeshConnected> Mesh;
+	/// <summary>
+	/// Body of the object, not added to the engine yet
+	/// </summary>
+	std::shared_ptr<chrono::ChBody> Body;
+};
 
 class Scene
 {
@@ -16,7 +60,14 @@ public:
 	/// <param name="layoutLibrary">The library containing the different layouts</param>
 	/// <param name="randomEngine">Random engine used to select a layout</param>
 	/// <param name="addToSystem">If true, the layout will be added to the engine, else its informations are stocked as ScaneLayout</param>
-	void AddLayout(chrono::ChSystemNSC& mphysicalSystem, ObjectLibrary layoutLibrary, std::default_random_engine& randomEngine, bool addToSystem);
+	void AddLayout(chrono::ChSystemNSC& mphysicalSystem, ObjectLibrary& layoutLibrary, std::default_random_engine& randomEngine, bool addToSystem);
+	/// <summary>
+	/// Use a given layout for the scene
+	/// </summary>
+	/// <param name="mphysicalSystem">The physical engine where the scene should be added</param>
+	/// <param name="layout">The layout to use</param>
+	/// <param name="addToSystem">If true, the layout will be added to the engine, else its informations are stocked as ScaneLayout</param>
+	void SetLayout(chrono::ChSystemNSC& mphysicalSystem, Object layout, bool addToSystem);
 	/// <summary>
 	/// Place a random number of large objects in the scene
 	/// </summary>
@@ -24,7 +75,7 @@ public:
 	/// <param name="library">The library from which objects should be drawn</param>
 	/// <param name="randomEngine">Random engine used to select the objects</param>
 	/// <param name="maxNumberOfLargeObject">The maximum number of object which should be added</param>
-	void AddLargeObjects(chrono::ChSystemNSC& mphysicalSystem, ObjectLibrary library, std::default_random_engine& randomEngine, int maxNumberOfLargeObject);
+	void AddLargeObjects(chrono::ChSystemNSC& mphysicalSystem, ObjectLibrary& library, std::default_random_engine& randomEngine, int maxNumberOfLargeObject);
 	/// <summary>
 	/// Place a random number of small objects in the scene
 	/// </summary>
@@ -32,8 +83,19 @@ public:
 	/// <param name="library">The library from which objects should be drawn</param>
 	/// <param name="randomEngine">Random engine used to select the objects</param>
 	/// <param name="maxNumberOfLargeObject">The maximum number of object which should be added</param>
-	/// <param name="placeOnLargeObject">If true, the small objects are placed on the bigger one (However, there is always a chance that they will fall during simulation)</param>
-	void AddSmallObjects(chrono::ChSystemNSC& mphysicalSystem, ObjectLibrary library, std::default_random_engine& randomEngine, int maxNumberOfSmallObject, bool placeOnLargeObject);
+	/// <param name="placeOnLargeObject">
+	/// If true, the small objects are placed on the bigger one (However, there is always a chance that they will fall during simulation).
+	/// The support surfaces are used when they have been extracted (see ExtractSupportSurfaces), else the large objects initial boundaries are used.
+	/// </param>
+	void AddSmallObjects(chrono::ChSystemNSC& mphysicalSystem, ObjectLibrary& library, std::default_random_engine& randomEngine, int maxNumberOfSmallObject, bool placeOnLargeObject);
+	/// <summary>
+	/// Extract the upward facing surfaces of the settled large objects, on which the small objects can be spawned.
+	/// Should be called once the large objects have stopped moving.
+	/// </summary>
+	/// <param name="maxTiltAngle">Maximum angle (rad) between a surface normal and the vertical axis</param>
+	/// <param name="minHeight">Minimum height (m) of a surface above the scene floor</param>
+	/// <returns>The number of support patches extracted</returns>
+	int ExtractSupportSurfaces(double maxTiltAngle = 0.25, double minHeight = 0.1);
 	/// <summary>
 	/// Add a ground to the scene, following the layout used. Useful when layout is added last
 	/// </summary>
@@ -55,14 +117,81 @@ public:
 	/// <param name="mass">Mass of the object during the simulation, 10.0 by default</param>
 	/// <param name="fixed">If fixed, the object can't be moved by collision (eg : a wall), false by defaults</param>
 	/// <param name="addToSystem">Will only be added to the physical engine if this parameter is set to yes, true by default.</param>
+	/// <param name="restOnPosition">If true, the object is lifted so that its lowest point lies on the given position, false by default.</param>
 	/// <returns>The pointer directed to the object in a format which can be used by Chrono++</returns>
 	std::shared_ptr<chrono::ChBody> AddObject(chrono::ChSystemNSC& mphysicalSystem, Object object, std::shared_ptr<chrono::ChMaterialSurfaceNSC>& commonMaterial,
-		std::default_random_engine randomEngine, chrono::Vector position, double rotationAngle = 0.0, bool useConvexHull = false, double mass = 10.0, bool fixed = false, bool addToSystem = true);
+		std::default_random_engine randomEngine, chrono::Vector position, double rotationAngle = 0.0, bool useConvexHull = false, double mass = 10.0, bool fixed = false, bool addToSystem = true, bool restOnPosition = false);
+	/// <summary>
+	/// Place an object with a known scale at the origin of the scene, its pose being set afterwards (eg : when restoring a checkpoint)
+	/// </summary>
+	/// <param name="mphysicalSystem">The physical engine which contains the scene where the object should be added</param>
+	/// <param name="object">The object to add</param>
+	/// <param name="scale">Scale to apply to the object mesh</param>
+	/// <param name="mass">Mass of the object during the simulation</param>
+	/// <returns>The pointer directed to the object in a format which can be used by Chrono++</returns>
+	std::shared_ptr<chrono::ChBody> RestoreObject(chrono::ChSystemNSC& mphysicalSystem, Object object, double scale, double mass);
+	/// <summary>
+	/// Create the contact material shared by the large or the small objects
+	/// </summary>
+	/// <param name="largeObject">If true, the material of the large objects is returned, else the one of the small objects</param>
+	static std::shared_ptr<chrono::ChMaterialSurfaceNSC> CreateObjectMaterial(bool largeObject);
+	/// <summary>
+	/// Remove a moving object from the physical engine and from the scene
+	/// </summary>
+	/// <param name="mphysicalSystem">The physical engine containing the object</param>
+	/// <param name="index">Index of the object in MovingObjects</param>
+	void RemoveMovingObject(chrono::ChSystem& mphysicalSystem, int index);
 	/// <summary>
 	/// Return the total area (m) contained in the scene
 	/// </summary>
 	double GetSceneArea();
 
+private:
+	/// <summary>
+	/// Load a copy of the welded mesh of an object, from the MeshLoader cache
+	/// </summary>
+	/// <param name="weldThreads">Threads welding the mesh if it is not cached yet, MeshLoader.NumberOfThreads if 0</param>
+	std::shared_ptr<chrono::geometry::ChTriangleMeshConnected> LoadMesh(Object& object, int weldThreads = 0);
+	/// <summary>
+	/// Scale a freshly loaded mesh
+	/// </summary>
+	void ScaleMesh(std::shared_ptr<chrono::geometry::ChTriangleMeshConnected> mesh, double scale);
+	/// <summary>
+	/// Build a body using the full mesh geometry for collision, placed at the origin
+	/// </summary>
+	/// <param name="mesh">The scaled mesh of the object</param>
+	/// <param name="material">Material associated to the object</param>
+	/// <param name="mass">Mass of the object during the simulation</param>
+	/// <param name="fixed">If fixed, the object can't be moved by collision</param>
+	std::shared_ptr<chrono::ChBody> BuildMeshBody(std::shared_ptr<chrono::geometry::ChTriangleMeshConnected> mesh, std::shared_ptr<chrono::ChMaterialSurfaceNSC> material, double mass, bool fixed);
+	/// <summary>
+	/// Set up a body which is not in the engine yet, using the full mesh geometry for collision (see BuildMeshBody)
+	/// </summary>
+	/// <param name="proxy">If not null, the collision model is this proxy of the mesh instead of the mesh itself</param>
+	void BuildMeshCollision(std::shared_ptr<chrono::ChBody> body, std::shared_ptr<chrono::geometry::ChTriangleMeshConnected> mesh, std::shared_ptr<chrono::ChMaterialSurfaceNSC> material, double mass, bool fixed,
+		const LayoutProxy* proxy = nullptr);
+	/// <summary>
+	/// Load and scale the mesh of a drawn object, and correct its position to the scene bounds.
+	/// If the object has a body, its collision model is built too. Does not touch the engine nor the scene lists, so it can run on any thread.
+	/// </summary>
+	/// <param name="weldThreads">Threads welding the mesh if it is not cached yet, MeshLoader.NumberOfThreads if 0</param>
+	void PrepareObject(PreparedObject& object, std::shared_ptr<chrono::ChMaterialSurfaceNSC> material, int weldThreads = 0);
+	/// <summary>
+	/// Create the bodies of drawn objects in their order, and prepare them over NumberOfThreads threads.
+	/// The threads are split between the objects and the welding of their meshes, so that no more than NumberOfThreads run at once.
+	/// </summary>
+	void PrepareObjects(std::vector<PreparedObject>& objects, std::shared_ptr<chrono::ChMaterialSurfaceNSC> material);
+	/// <summary>
+	/// In headless mode, free the cached model space meshes once the collision models are built (see HeadlessCachedVertices)
+	/// </summary>
+	void ReleaseSourceMeshes();
+	/// <summary>
+	/// Pose a prepared object, add it to the engine and record it in the scene
+	/// </summary>
+	/// <param name="addToSystem">Will only be added to the physical engine if this parameter is set to yes</param>
+	/// <returns>The body of the object</returns>
+	std::shared_ptr<chrono::ChBody> PlacePreparedObject(chrono::ChSystemNSC& mphysicalSystem, PreparedObject& object, bool addToSystem);
+
 
 public:
 	/// <summary>
@@ -78,6 +207,10 @@ public:
 	/// </summary>
 	std::vector<std::tuple<chrono::Vector, chrono::Vector>> LargeObjectsBoundaries;
 	/// <summary>
+	/// Support surfaces of the settled large objects, filled by ExtractSupportSurfaces
+	/// </summary>
+	SupportSurfaceIndex SupportSurfaces;
+	/// <summary>
 	/// The layout used in the scene
 	/// </summary>
 	Object UsedLayout;
@@ -89,5 +222,35 @@ public:
 	/// Pointer toward the scene layout as an object which can be used in the simulation
 	/// </summary>
 	std::shared_ptr<chrono::ChBody> SceneLayout;
+	/// <summary>
+	/// Mesh of the scene layout, expressed in the SceneLayout body frame
+	/// </summary>
+	std::shared_ptr<chrono::geometry::ChTriangleMeshConnected> LayoutMesh;
+	/// <summary>
+	/// Welds every loaded mesh once in model space, and caches the result for the following instances
+	/// </summary>
+	static MeshWelder MeshLoader;
+	/// <summary>
+	/// If true, no visualization asset is built, and the MeshLoader cache is trimmed to HeadlessCachedVertices once the objects are prepared
+	/// </summary>
+	static bool Headless;
+	/// <summary>
+	/// In headless mode, vertices the MeshLoader cache may keep between two preparations.
+	/// 0 by default : the model space meshes are freed once the collision models are built, and welded again at their next use.
+	/// </summary>
+	static size_t HeadlessCachedVertices;
+	/// <summary>
+	/// Threads loading the meshes and building the collision models of the objects placed together, every available core by default
+	/// </summary>
+	static int NumberOfThreads;
+	/// <summary>
+	/// Fits the layouts with primitives, and caches the result for the following scenes using the same layout
+	/// </summary>
+	static LayoutProxyBuilder LayoutProxies;
+	/// <summary>
+	/// If true, the collision model of the layout is its proxy (see LayoutProxy) instead of its full mesh.
+	/// Off by default until benchmark_layout_proxy shows the gain on the real layouts.
+	/// </summary>
+	static bool UseLayoutProxy;
 };
 
@@ -0,0 +1,259 @@
+#include "SceneCheckpoint.h"
+#include "ResultCache.h"
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <limits>
+
+
+namespace
+{
+    void WriteVector(std::ostream& outputStream, const chrono::Vector& vector)
+    {
+        outputStream << vector[0] << " " << vector[1] << " " << vector[2];
+    }
+
+    void ReadVector(std::istream& inputStream, chrono::Vector& vector)
+    {
+        inputStream >> vector[0] >> vector[1] >> vector[2];
+    }
+
+    // The file is written on its own line, as the library root can contain spaces
+    void WriteObject(std::ostream& outputStream, const Object& object)
+    {
+        outputStream << object.AssociatedFile << std::endl;
+        outputStream << object.Name << " " << object.Wnids << " " << object.MinVolume << " " << object.MaxVolume << " " << object.IsLargeObject << std::endl;
+    }
+
+    bool ReadObject(std::istream& inputStream, Object& object)
+    {
+        std::string file, line;
+        if (!std::getline(inputStream >> std::ws, file) || !std::getline(inputStream, line))
+            return false;
+        std::istringstream lineStream(line);
+        std::string name, wnids;
+        double minVolume, maxVolume;
+        bool isLarge;
+        if (!(lineStream >> name >> wnids >> minVolume >> maxVolume >> isLarge))
+            return false;
+        object = Object(name, file, wnids, minVolume, maxVolume, isLarge);
+        return true;
+    }
+
+    void CaptureLibraryDraws(ObjectLibrary& library, LibraryDraws& draws)
+    {
+        draws.Categories = library.DrawnCategories;
+        draws.Files.clear();
+        for (auto& file : library.DrawnFiles)
+        {
+            bool found;
+            draws.Files[file] = ResultCache::ComputeFileChecksum(file, found);
+        }
+    }
+
+    bool FilesUnchanged(const LibraryDraws& draws)
+    {
+        for (auto& file : draws.Files)
+        {
+            bool found;
+            if (ResultCache::ComputeFileChecksum(file.first, found) != file.second || !found)
+                return false;
+        }
+        return true;
+    }
+
+    // Categories and files are written one per line, as they can contain spaces
+    void WriteDraws(std::ostream& outputStream, const LibraryDraws& draws)
+    {
+        outputStream << draws.Categories.size() << std::endl;
+        for (auto& category : draws.Categories)
+            outputStream << category << std::endl;
+        outputStream << draws.Files.size() << std::endl;
+        for (auto& file : draws.Files)
+            outputStream << file.second << " " << file.first << std::endl;
+    }
+
+    bool ReadDraws(std::istream& inputStream, LibraryDraws& draws)
+    {
+        size_t numberOfCategories, numberOfFiles;
+        draws.Categories.clear();
+        draws.Files.clear();
+        if (!(inputStream >> numberOfCategories))
+            return false;
+        inputStream.ignore(1);
+        std::string line;
+        for (size_t i = 0; i < numberOfCategories; i++)
+        {
+            if (!std::getline(inputStream, line))
+                return false;
+            draws.Categories.insert(line);
+        }
+        if (!(inputStream >> numberOfFiles))
+            return false;
+        for (size_t i = 0; i < numberOfFiles; i++)
+        {
+            uint64_t checksum;
+            if (!(inputStream >> checksum) || !std::getline(inputStream.ignore(1), line))
+                return false;
+            draws.Files[line] = checksum;
+        }
+        return true;
+    }
+}
+
+
+SceneCheckpoint::SceneCheckpoint()
+{
+    Time = 0.0;
+}
+
+void SceneCheckpoint::Capture(chrono::ChSystemNSC& mphysicalSystem, Scene& scene)
+{
+    Time = mphysicalSystem.GetChTime();
+    Layout = scene.UsedLayout;
+    LargeObjectsBoundaries = scene.LargeObjectsBoundaries;
+
+    Bodies.clear();
+    for (auto& object : scene.MovingObjects)
+    {
+        std::shared_ptr<chrono::ChBody> body = object.CollisionBody;
+        BodyState state;
+        state.BaseObject = object.BaseObject;
+        state.Scale = object.Scale;
+        state.Mass = body->GetMass();
+        state.Position = body->GetPos();
+        state.Rotation = body->GetRot();
+        state.Velocity = body->GetPos_dt();
+        state.AngularVelocity = body->GetWvel_par();
+        state.Sleeping = body->GetSleeping();
+        Bodies.push_back(state);
+    }
+}
+
+Scene SceneCheckpoint::Restore(chrono::ChSystemNSC& mphysicalSystem)
+{
+    Scene scene;
+    scene.SetLayout(mphysicalSystem, Layout, false);
+    scene.AddGround(mphysicalSystem);
+    scene.LargeObjectsBoundaries = LargeObjectsBoundaries;
+
+    for (auto& state : Bodies)
+    {
+        std::shared_ptr<chrono::ChBody> body = scene.RestoreObject(mphysicalSystem, state.BaseObject, state.Scale, state.Mass);
+        body->SetPos(state.Position);
+        body->SetRot(state.Rotation);
+        body->SetPos_dt(state.Velocity);
+        body->SetWvel_par(state.AngularVelocity);
+        body->SetSleeping(state.Sleeping);
+    }
+
+    mphysicalSystem.SetChTime(Time);
+    return scene;
+}
+
+void SceneCheckpoint::CaptureDraws(ObjectLibrary& scenesLibrary, ObjectLibrary& library)
+{
+    CaptureLibraryDraws(scenesLibrary, LayoutDraws);
+    CaptureLibraryDraws(library, ObjectDraws);
+}
+
+bool SceneCheckpoint::RestoreDraws(ObjectLibrary& scenesLibrary, ObjectLibrary& library)
+{
+    if (!FilesUnchanged(LayoutDraws) || !FilesUnchanged(ObjectDraws))
+        return false;
+
+    scenesLibrary.DrawnCategories.insert(LayoutDraws.Categories.begin(), LayoutDraws.Categories.end());
+    library.DrawnCategories.insert(ObjectDraws.Categories.begin(), ObjectDraws.Categories.end());
+    for (auto& file : LayoutDraws.Files)
+        scenesLibrary.DrawnFiles.insert(file.first);
+    for (auto& file : ObjectDraws.Files)
+        library.DrawnFiles.insert(file.first);
+    return true;
+}
+
+bool SceneCheckpoint::Save(std::string filePath, std::string generation)
+{
+    std::ofstream outputStream(filePath);
+    if (!outputStream)
+        return false;
+
+    // Enough digits for the values to be read back exactly
+    outputStream << std::setprecision(std::numeric_limits<double>::max_digits10);
+    outputStream << "scene_checkpoint 3" << std::endl;
+    outputStream << generation << std::endl;
+    outputStream << Time << std::endl;
+    WriteObject(outputStream, Layout);
+
+    outputStream << LargeObjectsBoundaries.size() << std::endl;
+    for (auto& bound : LargeObjectsBoundaries)
+    {
+        WriteVector(outputStream, std::get<0>(bound));
+        outputStream << " ";
+        WriteVector(outputStream, std::get<1>(bound));
+        outputStream << std::endl;
+    }
+
+    outputStream << Bodies.size() << std::endl;
+    for (auto& state : Bodies)
+    {
+        WriteObject(outputStream, state.BaseObject);
+        outputStream << state.Scale << " " << state.Mass << std::endl;
+        WriteVector(outputStream, state.Position);
+        outputStream << std::endl;
+        outputStream << state.Rotation[0] << " " << state.Rotation[1] << " " << state.Rotation[2] << " " << state.Rotation[3] << std::endl;
+        WriteVector(outputStream, state.Velocity);
+        outputStream << std::endl;
+        WriteVector(outputStream, state.AngularVelocity);
+        outputStream << std::endl;
+        outputStream << state.Sleeping << std::endl;
+    }
+
+    WriteDraws(outputStream, LayoutDraws);
+    WriteDraws(outputStream, ObjectDraws);
+    return outputStream.good();
+}
+
+bool SceneCheckpoint::Load(std::string filePath, std::string generation)
+{
+    std::ifstream inputStream(filePath);
+    std::string header, savedGeneration;
+    int version;
+    if (!(inputStream >> header >> version) || header != "scene_checkpoint" || version != 3)
+        return false;
+    // Settled with other settings or other library entries, the objects would not be where this generation puts them
+    if (!std::getline(inputStream >> std::ws, savedGeneration) || savedGeneration != generation)
+        return false;
+
+    if (!(inputStream >> Time) || !ReadObject(inputStream, Layout))
+        return false;
+
+    size_t numberOfBounds;
+    inputStream >> numberOfBounds;
+    LargeObjectsBoundaries.clear();
+    for (size_t i = 0; i < numberOfBounds && inputStream; i++)
+    {
+        chrono::Vector minBound, maxBound;
+        ReadVector(inputStream, minBound);
+        ReadVector(inputStream, maxBound);
+        LargeObjectsBoundaries.push_back(std::tuple<chrono::Vector, chrono::Vector>(minBound, maxBound));
+    }
+
+    size_t numberOfBodies;
+    inputStream >> numberOfBodies;
+    Bodies.clear();
+    for (size_t i = 0; i < numberOfBodies && inputStream; i++)
+    {
+        BodyState state;
+        if (!ReadObject(inputStream, state.BaseObject))
+            return false;
+        inputStream >> state.Scale >> state.Mass;
+        ReadVector(inputStream, state.Position);
+        inputStream >> state.Rotation[0] >> state.Rotation[1] >> state.Rotation[2] >> state.Rotation[3];
+        ReadVector(inputStream, state.Velocity);
+        ReadVector(inputStream, state.AngularVelocity);
+        inputStream >> state.Sleeping;
+        Bodies.push_back(state);
+    }
+
+    return !inputStream.fail() && Bodies.size() == numberOfBodies && ReadDraws(inputStream, LayoutDraws) && ReadDraws(inputStream, ObjectDraws);
+}
@@ -0,0 +1,133 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <cstdint>
+#include "Scene.h"
+#include "ObjectLibrary.h"
+
+/// <summary>
+/// State of a moving body, enough to rebuild it in another physical engine
+/// </summary>
+struct BodyState
+{
+	/// <summary>
+	/// Object definition
+	/// </summary>
+	Object BaseObject;
+	/// <summary>
+	/// Scale of the object, compared to the defining mesh size
+	/// </summary>
+	double Scale;
+	/// <summary>
+	/// Mass of the body (kg)
+	/// </summary>
+	double Mass;
+	/// <summary>
+	/// Position of the body reference frame
+	/// </summary>
+	chrono::Vector Position;
+	/// <summary>
+	/// Orientation of the body reference frame
+	/// </summary>
+	chrono::Quaternion Rotation;
+	/// <summary>
+	/// Linear velocity, in the world frame
+	/// </summary>
+	chrono::Vector Velocity;
+	/// <summary>
+	/// Angular velocity, in the world frame
+	/// </summary>
+	chrono::Vector AngularVelocity;
+	/// <summary>
+	/// True if the body was sleeping at capture
+	/// </summary>
+	bool Sleeping;
+};
+
+/// <summary>
+/// Entries of a library drawn to build a scene
+/// </summary>
+struct LibraryDraws
+{
+	/// <summary>
+	/// Drawn categories
+	/// </summary>
+	std::set<std::string> Categories;
+	/// <summary>
+	/// Drawn mesh files, with the checksum of their content when they were drawn
+	/// </summary>
+	std::map<std::string, uint64_t> Files;
+};
+
+/// <summary>
+/// Snapshot of a simulated scene (typically once the large objects have settled), from which several scene variants can be forked
+/// </summary>
+class SceneCheckpoint
+{
+public:
+	SceneCheckpoint();
+	/// <summary>
+	/// Record the current state of a scene
+	/// </summary>
+	/// <param name="mphysicalSystem">The physical engine containing the scene</param>
+	/// <param name="scene">The scene to record</param>
+	void Capture(chrono::ChSystemNSC& mphysicalSystem, Scene& scene);
+	/// <summary>
+	/// Rebuild the recorded scene in a physical engine, which should not contain the scene yet.
+	/// Solver warm start informations are not recorded, so the following simulation can slightly differ from the original one.
+	/// </summary>
+	/// <param name="mphysicalSystem">The physical engine where the scene is rebuilt</param>
+	/// <returns>The rebuilt scene, with the layout stocked as SceneLayout but not added to the engine</returns>
+	Scene Restore(chrono::ChSystemNSC& mphysicalSystem);
+	/// <summary>
+	/// Record the entries drawn from the libraries since their draw history was cleared, with the checksums of the drawn meshes
+	/// </summary>
+	void CaptureDraws(ObjectLibrary& scenesLibrary, ObjectLibrary& library);
+	/// <summary>
+	/// Add the recorded entries to the draw history of the libraries, as if the scene had been built again, so that it can be stored in a result cache
+	/// </summary>
+	/// <returns>False if a drawn mesh changed since the capture : the checkpoint is then stale and the draw history is left as is</returns>
+	bool RestoreDraws(ObjectLibrary& scenesLibrary, ObjectLibrary& library);
+	/// <summary>
+	/// Write the checkpoint to a file
+	/// </summary>
+	/// <param name="filePath">Path of the file to write</param>
+	/// <param name="generation">Settings and libraries of the generation, written in the header (single line)</param>
+	/// <returns>False if the file could not be written</returns>
+	bool Save(std::string filePath, std::string generation);
+	/// <summary>
+	/// Read a checkpoint written by Save
+	/// </summary>
+	/// <param name="filePath">Path of the file to read</param>
+	/// <param name="generation">Current settings and libraries of the generation, the checkpoint is rejected if it was saved with others</param>
+	/// <returns>False if the file could not be read or was saved for another generation</returns>
+	bool Load(std::string filePath, std::string generation);
+
+public:
+	/// <summary>
+	/// Simulation time at capture (s)
+	/// </summary>
+	double Time;
+	/// <summary>
+	/// The layout used in the scene
+	/// </summary>
+	Object Layout;
+	/// <summary>
+	/// Each of the placed large objects boundaries, as they were when the objects were added
+	/// </summary>
+	std::vector<std::tuple<chrono::Vector, chrono::Vector>> LargeObjectsBoundaries;
+	/// <summary>
+	/// State of every moving object of the scene
+	/// </summary>
+	std::vector<BodyState> Bodies;
+	/// <summary>
+	/// Entries drawn from the scenes library (the layout)
+	/// </summary>
+	LibraryDraws LayoutDraws;
+	/// <summary>
+	/// Entries drawn from the objects library (the large objects)
+	/// </summary>
+	LibraryDraws ObjectDraws;
+};
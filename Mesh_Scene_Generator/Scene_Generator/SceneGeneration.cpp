@@ -0,0 +1,387 @@
+#include "SceneGeneration.h"
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include "chrono/solver/ChSolverPSOR.h"
+#include "CheckCollisions.h"
+#include "MemoryUsage.h"
+#include "Log.h"
+
+using namespace chrono;
+
+
+Scene create_scene(ChSystemNSC& mphysicalSystem, ObjectLibrary& scenesLibrary, std::default_random_engine& randomEngine)
+{
+    Scene scene;
+    scene.AddLayout(mphysicalSystem, scenesLibrary, randomEngine, false);
+    scene.AddGround(mphysicalSystem);
+
+    return scene;
+}
+
+std::vector<PlacedObject> select_output_objects(chrono::ChSystem& mphysicalSystem, std::vector<PlacedObject>& objects)
+{
+    std::vector<PlacedObject> selectedObjects;
+    auto collision_checker = chrono_types::make_shared<CheckCollisions>();
+    mphysicalSystem.GetContactContainer()->ReportAllContacts(collision_checker);
+
+    for (auto object : objects)
+    {
+        PlacedObject& this_object = object;
+        std::shared_ptr<ChBody>body = this_object.CollisionBody;
+        ChContactable* a_contact = body->GetCollisionModel()->GetContactable();
+        if (collision_checker->contacts[a_contact])
+        {
+            Log::Out() << "Body in bad contact" << this_object.BaseObject.AssociatedFile << std::endl;
+            continue;
+        }
+        ChVector<>   mypos = body->GetPos();
+        if (mypos[1] < -7)
+        {
+            Log::Out() << "Body below threshold" << this_object.BaseObject.AssociatedFile << std::endl;
+            continue;
+        }
+        ChVector<> speed = body->GetPos_dt();
+        if (speed.Length() > 1.0)
+        {
+            Log::Out() << "Body still moving" << this_object.BaseObject.AssociatedFile << std::endl;
+            Log::Out() << "Speed" << speed.Length() << std::endl;
+            continue;
+        }
+        ChVector<> rot = body->GetWvel_loc();
+        if (rot.Length() > 2.0)
+        {
+            Log::Out() << "Body still spinning" << this_object.BaseObject.AssociatedFile << std::endl;
+            Log::Out() << "Rot" << rot.Length() << std::endl;
+            continue;
+        }
+
+        Log::Out() << "Adding " << this_object.BaseObject.AssociatedFile << " at x:" << mypos[0] << " y:" << mypos[1] << " z:" << mypos[2] << std::endl;
+        selectedObjects.push_back(this_object);
+    }
+    return selectedObjects;
+}
+
+std::vector<ObjectPose> get_object_poses(std::vector<PlacedObject>& objects)
+{
+    std::vector<ObjectPose> poses;
+    poses.reserve(objects.size());
+    for (auto& object : objects)
+        poses.push_back({ object.BaseObject, object.Scale, object.CollisionBody->Amatrix, object.CollisionBody->GetPos() });
+    return poses;
+}
+
+void write_poses(std::ostream& outputStream, const std::string& layoutPath, const std::vector<ObjectPose>& poses)
+{
+    outputStream << "layout_file:" << layoutPath << std::endl;
+    for (auto& pose : poses)
+    {
+        const ChMatrix33<>& myRot = pose.Rotation;
+        const ChVector<>& mypos = pose.Position;
+        outputStream << pose.BaseObject.AssociatedFile << std::endl;
+        outputStream << pose.BaseObject.Wnids << std::endl;
+        outputStream << pose.Scale << std::endl;
+        outputStream << myRot(0) << " " << myRot(1) << " " << myRot(2) << " " << mypos[0] << std::endl;
+        outputStream << myRot(3) << " " << myRot(4) << " " << myRot(5) << " " << mypos[1] << std::endl;
+        outputStream << myRot(6) << " " << myRot(7) << " " << myRot(8) << " " << mypos[2] << std::endl;
+    }
+}
+
+std::vector<PlacedObject> OutputSimulationToStream(std::ostream& outputStream, chrono::ChSystem& mphysicalSystem, std::string& layoutPath, std::vector<PlacedObject>& objects)
+{
+    std::vector<PlacedObject> writtenObjects = select_output_objects(mphysicalSystem, objects);
+    write_poses(outputStream, layoutPath, get_object_poses(writtenObjects));
+    return writtenObjects;
+}
+
+void removeBadContactObjects(chrono::ChSystem& mphysicalSystem, Scene& scene)
+{
+    auto collision_checker = chrono_types::make_shared<CheckCollisions>();
+    mphysicalSystem.GetContactContainer()->ReportAllContacts(collision_checker);
+
+    std::vector<chrono::ChContactable*> toIgnore;
+
+    for (int i = scene.MovingObjects.size() - 1; i > -1; i--)
+    {
+        std::shared_ptr<chrono::ChBody> currentObject = scene.MovingObjects[i].CollisionBody;
+        ChContactable* contact = currentObject->GetCollisionModel()->GetContactable();
+        if (collision_checker->contacts[contact])
+        {
+            if (!(std::find(toIgnore.begin(), toIgnore.end(), contact) != toIgnore.end()))
+            {
+                toIgnore.push_back(collision_checker->linkedContactable[contact]);
+                Log::Out() << "Removing from scene due to bad contact " << scene.MovingObjects[i].BaseObject.AssociatedFile << std::endl;
+                scene.RemoveMovingObject(mphysicalSystem, i);
+            }
+            else
+            {
+                Log::Out() << "Uping due to bad contact " << scene.MovingObjects[i].BaseObject.AssociatedFile << std::endl;
+                currentObject->RemoveAllForces();
+                chrono::Vector currentPos = currentObject->GetPos();
+                currentObject->SetPos(chrono::Vector(currentPos[0], currentPos[1] + 0.1, currentPos[2]));
+            }
+        }
+    }
+}
+
+double chooseStep(ChSystem& mphysicalSystem, double endTime, TimestepController& controller)
+{
+    return std::min(controller.GetStep(), std::max(endTime - mphysicalSystem.GetChTime(), controller.MinStep));
+}
+
+void runSimulationFor(ChSystemNSC& mphysicalSystem, double duration, Scene& scene, BodyCuller& culler, PhysicsTelemetry& telemetry, TimestepController& controller)
+{
+    // Half of the smallest step of tolerance, so that accumulated rounding errors do not add an extra step
+    double endTime = mphysicalSystem.GetChTime() + duration;
+    while (mphysicalSystem.GetChTime() < endTime - 0.5 * controller.MinStep)
+    {
+        telemetry.BeginStep();
+        mphysicalSystem.DoStepDynamics(chooseStep(mphysicalSystem, endTime, controller));
+        telemetry.EndStep(mphysicalSystem);
+        MemoryUsage::Sample();
+        controller.OnStep(mphysicalSystem, telemetry.GetLastStep());
+        culler.OnStep(mphysicalSystem, scene);
+    }
+}
+
+void configure_system(ChSystemNSC& mphysicalSystem)
+{
+    auto solver = chrono_types::make_shared<ChSolverPSOR>();
+    solver->SetMaxIterations(40);
+    solver->EnableWarmStart(true);
+    mphysicalSystem.SetSolver(solver);
+
+    mphysicalSystem.SetMaxPenetrationRecoverySpeed(2.0);
+    mphysicalSystem.SetMinBounceSpeed(50.0);
+    mphysicalSystem.SetStep(0.02);
+}
+
+void settle_large_objects(ChSystemNSC& mphysicalSystem, Scene& scene, BodyCuller& culler, PhysicsTelemetry& telemetry, TimestepController& controller)
+{
+    telemetry.SetPhase("large_objects");
+    for (int i = 0; i < 10; i++)
+    {
+        runSimulationFor(mphysicalSystem, 0.5, scene, culler, telemetry, controller);
+        removeBadContactObjects(mphysicalSystem, scene);
+    }
+}
+
+void settle_scene(ObjectLibrary& scenesLibrary, ObjectLibrary& library, unsigned int seed, SceneCheckpoint& checkpoint, PhysicsTelemetry& telemetry)
+{
+    Log::Out() << "Beginning simulation, seed " << seed << std::endl;
+    ChSystemNSC mphysicalSystem;
+    configure_system(mphysicalSystem);
+    std::default_random_engine randomEngine(seed);
+    Scene scene = create_scene(mphysicalSystem, scenesLibrary, randomEngine);
+    scene.AddLargeObjects(mphysicalSystem, library, randomEngine, (int)scene.GetSceneArea() / 2.0);
+    BodyCuller culler;
+    TimestepController controller(mphysicalSystem.GetStep());
+    settle_large_objects(mphysicalSystem, scene, culler, telemetry, controller);
+    culler.PrintReport(Log::Out());
+    controller.PrintReport(Log::Out());
+
+    checkpoint.Capture(mphysicalSystem, scene);
+}
+
+GeneratedVariant generate_variant(SceneCheckpoint& checkpoint, ObjectLibrary& library, unsigned int seed, PointCloudProcessor* pointCloudProcessor, PhysicsTelemetry& telemetry)
+{
+    ChSystemNSC mphysicalSystem;
+    configure_system(mphysicalSystem);
+    Scene scene = checkpoint.Restore(mphysicalSystem);
+    std::default_random_engine randomEngine(seed);
+    BodyCuller culler;
+    TimestepController controller(mphysicalSystem.GetStep());
+
+    Log::Out() << "Adding small objects, seed " << seed << std::endl;
+    telemetry.SetPhase("small_objects");
+    scene.ExtractSupportSurfaces();
+    scene.AddSmallObjects(mphysicalSystem, library, randomEngine, (int)scene.GetSceneArea() * 2, true);
+    runSimulationFor(mphysicalSystem, 0.04, scene, culler, telemetry, controller);
+    removeBadContactObjects(mphysicalSystem, scene);
+    for (int i = 0; i < 9; i++)
+    {
+        runSimulationFor(mphysicalSystem, 0.5, scene, culler, telemetry, controller);
+        removeBadContactObjects(mphysicalSystem, scene);
+    }
+
+    Log::Out() << "Adding scene" << std::endl;
+    telemetry.SetPhase("layout_insertion");
+    mphysicalSystem.AddBody(scene.SceneLayout);
+    // The layout appears around the objects at once, small steps avoid tunnelling through its walls
+    controller.Restart();
+    runSimulationFor(mphysicalSystem, controller.GetStep(), scene, culler, telemetry, controller);
+    removeBadContactObjects(mphysicalSystem, scene);
+    runSimulationFor(mphysicalSystem, 0.25, scene, culler, telemetry, controller);
+
+    culler.PrintReport(Log::Out());
+    controller.PrintReport(Log::Out());
+
+    GeneratedVariant variant;
+    variant.LayoutFile = scene.UsedLayout.AssociatedFile;
+    std::vector<PlacedObject> writtenObjects = select_output_objects(mphysicalSystem, scene.MovingObjects);
+    variant.Objects = get_object_poses(writtenObjects);
+
+    if (pointCloudProcessor)
+    {
+        // The sensor stands in the middle of the room, at eye level
+        pointCloudProcessor->Seed = seed;
+        pointCloudProcessor->SensorPosition = chrono::Vector(0.5 * (scene.SceneBoundingBoxMin[0] + scene.SceneBoundingBoxMax[0]),
+            scene.SceneBoundingBoxMin[1] + 1.6, 0.5 * (scene.SceneBoundingBoxMin[2] + scene.SceneBoundingBoxMax[2]));
+        variant.Cloud = pointCloudProcessor->SampleScene(scene, writtenObjects, library);
+        pointCloudProcessor->Process(variant.Cloud);
+    }
+    return variant;
+}
+
+void simulate_small_objects_variant(SceneCheckpoint& checkpoint, ObjectLibrary& library, unsigned int seed, std::string outputPath, PointCloudProcessor* pointCloudProcessor, PhysicsTelemetry& telemetry)
+{
+    GeneratedVariant variant = generate_variant(checkpoint, library, seed, pointCloudProcessor, telemetry);
+
+    std::ofstream outputStream(outputPath);
+    write_poses(outputStream, variant.LayoutFile, variant.Objects);
+    outputStream.close();
+
+    if (pointCloudProcessor)
+        pointCloudProcessor->Save(variant.Cloud, outputPath + "_cloud");
+}
+
+std::string describe_generation(int numberOfVariants, PointCloudProcessor* pointCloudProcessor)
+{
+    std::ostringstream description;
+    description.precision(17);
+    description << "variants " << numberOfVariants << " weld " << Scene::MeshLoader.Tolerance;
+    // The controller and the culler are built as in settle_scene and simulate_small_objects_variant, so that a change of their defaults changes the keys
+    ChSystemNSC mphysicalSystem;
+    configure_system(mphysicalSystem);
+    TimestepController controller(mphysicalSystem.GetStep());
+    BodyCuller culler;
+    description << " timestep " << mphysicalSystem.GetStep() << " " << controller.MinStep << " " << controller.MaxStep << " " << controller.GrowthFactor
+        << " " << controller.ShrinkFactor << " " << controller.MaxTravel << " " << controller.MaxPenetration << " " << controller.ContactJumpFraction
+        << " " << controller.ContactJumpMinimum;
+    description << " culler " << culler.CheckPeriod << " " << culler.FallThreshold << " " << culler.EscapeMargin << " " << culler.MaxSpeed
+        << " " << culler.PenetrationThreshold << " " << culler.StuckDuration;
+    if (Scene::UseLayoutProxy)
+        description << " layout_proxy " << Scene::LayoutProxies.PlaneTolerance << " " << Scene::LayoutProxies.CellSize << " " << Scene::LayoutProxies.Thickness
+            << " " << Scene::LayoutProxies.MaxBoxesPerPlane << " " << Scene::LayoutProxies.MinAxisAlignment;
+    if (pointCloudProcessor)
+        description << " cloud " << pointCloudProcessor->SamplingDensity << " " << pointCloudProcessor->VoxelSize << " " << pointCloudProcessor->NormalRadius
+            << " " << pointCloudProcessor->NoiseBase << " " << pointCloudProcessor->NoisePerSquareMeter << " " << pointCloudProcessor->DropoutBase
+            << " " << pointCloudProcessor->DropoutPerMeter << " " << pointCloudProcessor->DropoutGrazing << " " << pointCloudProcessor->RangeResolution;
+    return description.str();
+}
+
+std::unique_ptr<ResultCache> open_result_cache(std::string cacheDirectory, ObjectLibrary& scenesLibrary, ObjectLibrary& library, int numberOfVariants,
+    PointCloudProcessor* pointCloudProcessor)
+{
+    if (cacheDirectory.empty())
+        return nullptr;
+    std::unique_ptr<ResultCache> cache(new ResultCache(cacheDirectory, describe_generation(numberOfVariants, pointCloudProcessor)));
+    cache->AddLibrary("scenes", scenesLibrary);
+    cache->AddLibrary("objects", library);
+    return cache;
+}
+
+void generate_scene(ObjectLibrary& scenesLibrary, ObjectLibrary& library, unsigned int seed, std::string checkpointPath, std::string outputPath, int numberOfVariants,
+    PointCloudProcessor* pointCloudProcessor, PhysicsTelemetry& telemetry, ResultCache* cache)
+{
+    if (cache && cache->Restore(seed, outputPath))
+    {
+        Log::Out() << "Scene of seed " << seed << " unchanged, outputs read from the result cache" << std::endl;
+        return;
+    }
+    // The draws recorded in the checkpoint and in the cache must be those of this scene only
+    scenesLibrary.ClearDrawHistory();
+    library.ClearDrawHistory();
+
+    bool peakReset = MemoryUsage::ResetPeak();
+    // The checkpoint is only valid for the settings and the library entries it was settled with
+    std::ostringstream generation;
+    generation << describe_generation(numberOfVariants, pointCloudProcessor) << " libraries " << std::hex
+        << ResultCache::ComputeLibraryChecksum(scenesLibrary) << " " << ResultCache::ComputeLibraryChecksum(library);
+    SceneCheckpoint checkpoint;
+    // The draws of the layout and of the large objects are taken from the checkpoint, so that the scene can still be cached
+    if (!checkpointPath.empty() && checkpoint.Load(checkpointPath, generation.str()) && checkpoint.RestoreDraws(scenesLibrary, library))
+        Log::Out() << "Settled large objects read from " << checkpointPath << std::endl;
+    else
+    {
+        settle_scene(scenesLibrary, library, seed, checkpoint, telemetry);
+        checkpoint.CaptureDraws(scenesLibrary, library);
+        if (!checkpointPath.empty() && !checkpoint.Save(checkpointPath, generation.str()))
+            Log::Out() << "Could not save checkpoint to " << checkpointPath << std::endl;
+    }
+
+    std::vector<std::string> outputSuffixes;
+    for (int variant = 0; variant < numberOfVariants; variant++)
+    {
+        simulate_small_objects_variant(checkpoint, library, seed + 1 + variant, outputPath + std::to_string(variant), pointCloudProcessor, telemetry);
+        outputSuffixes.push_back(std::to_string(variant));
+        if (pointCloudProcessor)
+            outputSuffixes.push_back(std::to_string(variant) + "_cloud");
+    }
+    // The labels of the clouds depend on the whole library, each scene keeps the table it was labelled with
+    if (pointCloudProcessor)
+    {
+        std::ofstream labelsStream(outputPath + "labels");
+        library.WriteLabels(labelsStream);
+        outputSuffixes.push_back("labels");
+    }
+
+    if (cache && !cache->Store(seed, outputPath, outputSuffixes))
+        Log::Out() << "Could not store the scene of seed " << seed << " in the result cache" << std::endl;
+
+    Log::Out() << "Peak resident memory : " << MemoryUsage::GetPeakResident() / 1048576.0 << " MB"
+        << (!peakReset ? " (since the process start)" : MemoryUsage::PeakIsSampled() ? " (sampled after each step)" : "") << std::endl;
+}
+
+void benchmark_layout_proxy(std::string layoutPath, ObjectLibrary& library, unsigned int seed, int maxNumberOfObjects, double duration, std::ostream& outputStream)
+{
+    bool useLayoutProxy = Scene::UseLayoutProxy;
+    Object layout(std::string("layout"), layoutPath, std::string("000"), 1.0, 1.0, true);
+    // Loaded once beforehand, so that the loading time is not counted in the first run
+    Scene::MeshLoader.GetSharedMesh(layoutPath);
+    chrono::Vector boundingBoxMin, boundingBoxMax;
+
+    for (int run = 0; run < 2; run++)
+    {
+        Scene::UseLayoutProxy = run == 1;
+        ChSystemNSC mphysicalSystem;
+        configure_system(mphysicalSystem);
+        Scene scene;
+        auto start = std::chrono::steady_clock::now();
+        scene.SetLayout(mphysicalSystem, layout, true);
+        std::chrono::duration<double> setupTime = std::chrono::steady_clock::now() - start;
+
+        // The bounds of the full mesh run are kept, so that both runs draw the same objects at the same places
+        if (run == 0)
+        {
+            boundingBoxMin = scene.SceneBoundingBoxMin;
+            boundingBoxMax = scene.SceneBoundingBoxMax;
+        }
+        scene.SceneBoundingBoxMin = boundingBoxMin;
+        scene.SceneBoundingBoxMax = boundingBoxMax;
+        std::default_random_engine randomEngine(seed);
+        scene.AddSmallObjects(mphysicalSystem, library, randomEngine, maxNumberOfObjects, false);
+        if (run == 0)
+            outputStream << layoutPath << " : " << scene.MovingObjects.size() << " library objects of seed " << seed << " dropped during " << duration << " s" << std::endl;
+
+        int steps = 0;
+        long long contacts = 0;
+        start = std::chrono::steady_clock::now();
+        while (mphysicalSystem.GetChTime() < duration)
+        {
+            mphysicalSystem.DoStepDynamics(mphysicalSystem.GetStep());
+            contacts += mphysicalSystem.GetNcontacts();
+            steps++;
+        }
+        std::chrono::duration<double> simulationTime = std::chrono::steady_clock::now() - start;
+
+        outputStream << (Scene::UseLayoutProxy ? "  Proxy" : "  Full mesh") << " : layout setup in " << setupTime.count() << " s, " << steps << " steps in "
+            << simulationTime.count() << " s (" << 1000.0 * simulationTime.count() / std::max(1, steps) << " ms per step), "
+            << (double)contacts / std::max(1, steps) << " contacts per step" << std::endl;
+    }
+
+    Scene::UseLayoutProxy = useLayoutProxy;
+}
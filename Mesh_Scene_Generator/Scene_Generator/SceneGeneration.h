@@ -0,0 +1,140 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <memory>
+#include <ostream>
+#include <random>
+#include "chrono/physics/ChSystemNSC.h"
+#include "Scene.h"
+#include "ObjectLibrary.h"
+#include "BodyCuller.h"
+#include "SceneCheckpoint.h"
+#include "PointCloudProcessor.h"
+#include "PhysicsTelemetry.h"
+#include "ResultCache.h"
+#include "TimestepController.h"
+
+/// <summary>
+/// Final pose of an object of a generated scene
+/// </summary>
+struct ObjectPose
+{
+	/// <summary>
+	/// Object definition
+	/// </summary>
+	Object BaseObject;
+	/// <summary>
+	/// Scale of the object, compared to the defining mesh size
+	/// </summary>
+	double Scale;
+	/// <summary>
+	/// Orientation of the object in the world frame
+	/// </summary>
+	chrono::ChMatrix33<> Rotation;
+	/// <summary>
+	/// Position of the object reference frame in the world frame
+	/// </summary>
+	chrono::Vector Position;
+};
+
+/// <summary>
+/// Result of the simulation of one small objects variant, held in memory
+/// </summary>
+struct GeneratedVariant
+{
+	/// <summary>
+	/// Mesh file of the scene layout
+	/// </summary>
+	std::string LayoutFile;
+	/// <summary>
+	/// Objects kept in the output, at rest and without bad contacts
+	/// </summary>
+	std::vector<ObjectPose> Objects;
+	/// <summary>
+	/// Post processed point cloud of the scene, empty if no point cloud processor was given
+	/// </summary>
+	PointCloud Cloud;
+};
+
+/// <summary>
+/// Solver and step settings shared by every simulation
+/// </summary>
+void configure_system(chrono::ChSystemNSC& mphysicalSystem);
+/// <summary>
+/// Create a scene with a random layout (not added to the engine yet) and the ground
+/// </summary>
+Scene create_scene(chrono::ChSystemNSC& mphysicalSystem, ObjectLibrary& scenesLibrary, std::default_random_engine& randomEngine);
+/// <summary>
+/// Remove the objects in bad contact, or lift them if the other body of the contact was already removed
+/// </summary>
+void removeBadContactObjects(chrono::ChSystem& mphysicalSystem, Scene& scene);
+/// <summary>
+/// Size of the next step, shortened so that the last step ends on endTime
+/// </summary>
+double chooseStep(chrono::ChSystem& mphysicalSystem, double endTime, TimestepController& controller);
+/// <summary>
+/// Simulate the engine for a duration (s), with the step sizes chosen by the controller
+/// </summary>
+void runSimulationFor(chrono::ChSystemNSC& mphysicalSystem, double duration, Scene& scene, BodyCuller& culler, PhysicsTelemetry& telemetry, TimestepController& controller);
+/// <summary>
+/// Objects of a simulated scene which are kept in the output : not in bad contact, not fallen, and at rest
+/// </summary>
+std::vector<PlacedObject> select_output_objects(chrono::ChSystem& mphysicalSystem, std::vector<PlacedObject>& objects);
+/// <summary>
+/// Current pose of each object
+/// </summary>
+std::vector<ObjectPose> get_object_poses(std::vector<PlacedObject>& objects);
+/// <summary>
+/// Write the layout file and the pose of each object, in the output text format
+/// </summary>
+void write_poses(std::ostream& outputStream, const std::string& layoutPath, const std::vector<ObjectPose>& poses);
+/// <summary>
+/// Write the objects kept in the output of a simulated scene
+/// </summary>
+/// <returns>The written objects</returns>
+std::vector<PlacedObject> OutputSimulationToStream(std::ostream& outputStream, chrono::ChSystem& mphysicalSystem, std::string& layoutPath, std::vector<PlacedObject>& objects);
+/// <summary>
+/// Simulate the large objects until they settle
+/// </summary>
+void settle_large_objects(chrono::ChSystemNSC& mphysicalSystem, Scene& scene, BodyCuller& culler, PhysicsTelemetry& telemetry, TimestepController& controller);
+/// <summary>
+/// Draw the layout and the large objects of a scene from its seed, and capture them once settled
+/// </summary>
+void settle_scene(ObjectLibrary& scenesLibrary, ObjectLibrary& library, unsigned int seed, SceneCheckpoint& checkpoint, PhysicsTelemetry& telemetry);
+/// <summary>
+/// Add small objects to the settled large objects of a checkpoint, then the layout, and simulate until the scene is at rest
+/// </summary>
+/// <param name="pointCloudProcessor">If not nullptr, a point cloud of the result is sampled and processed</param>
+GeneratedVariant generate_variant(SceneCheckpoint& checkpoint, ObjectLibrary& library, unsigned int seed, PointCloudProcessor* pointCloudProcessor, PhysicsTelemetry& telemetry);
+/// <summary>
+/// Generate a variant and write it to outputPath, and its point cloud to outputPath_cloud
+/// </summary>
+void simulate_small_objects_variant(SceneCheckpoint& checkpoint, ObjectLibrary& library, unsigned int seed, std::string outputPath, PointCloudProcessor* pointCloudProcessor, PhysicsTelemetry& telemetry);
+/// <summary>
+/// Every setting of a headless generation which changes its outputs, used as part of the result cache keys.
+/// Other constants of the code (solver, materials, phase durations) are not listed : changing them requires bumping ResultCache::GeneratorVersion.
+/// </summary>
+std::string describe_generation(int numberOfVariants, PointCloudProcessor* pointCloudProcessor);
+/// <summary>
+/// Result cache of a headless generation, nullptr if no cache directory is given
+/// </summary>
+std::unique_ptr<ResultCache> open_result_cache(std::string cacheDirectory, ObjectLibrary& scenesLibrary, ObjectLibrary& library, int numberOfVariants,
+	PointCloudProcessor* pointCloudProcessor);
+/// <summary>
+/// Generate a scene and its small objects variants, written to outputPath[variant].
+/// With a point cloud processor, the clouds are written to outputPath[variant]_cloud and their label table to outputPath + "labels".
+/// </summary>
+/// <param name="checkpointPath">The settled large objects are read from there if it exists and was saved with the same settings and library entries,
+/// else they are simulated and saved there. No checkpoint is used if empty.</param>
+/// <param name="cache">If not nullptr, the scene is read from the cache when unchanged, and stored in it once generated</param>
+void generate_scene(ObjectLibrary& scenesLibrary, ObjectLibrary& library, unsigned int seed, std::string checkpointPath, std::string outputPath, int numberOfVariants,
+	PointCloudProcessor* pointCloudProcessor, PhysicsTelemetry& telemetry, ResultCache* cache);
+/// <summary>
+/// Drop the same small objects of the library on a layout with its full mesh collision model and with its proxy, and write the timings of both simulations
+/// </summary>
+/// <param name="layoutPath">Mesh file of the layout</param>
+/// <param name="library">The library from which the small objects are drawn, as in AddSmallObjects</param>
+/// <param name="seed">Seed of the drawing, the same for both runs</param>
+/// <param name="maxNumberOfObjects">The maximum number of dropped objects</param>
+/// <param name="duration">Simulated duration (s)</param>
+void benchmark_layout_proxy(std::string layoutPath, ObjectLibrary& library, unsigned int seed, int maxNumberOfObjects, double duration, std::ostream& outputStream);
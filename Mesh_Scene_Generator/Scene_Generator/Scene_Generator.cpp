@@ -5,8 +5,9 @@
 // =============================================================================
 
 
+#include <memory>
+
 #include "chrono/physics/ChSystemNSC.h"
-#include "chrono/solver/ChSolverPSOR.h"
 #include "chrono/assets/ChTexture.h"
 #include "chrono/physics/ChBodyEasy.h"
 
@@ -14,7 +15,14 @@
 
 #include "ObjectLibrary.h"
 #include "Scene.h"
-#include "CheckCollisions.h"
+#include "BodyCuller.h"
+#include "SceneCheckpoint.h"
+#include "PointCloudProcessor.h"
+#include "PhysicsTelemetry.h"
+#include "WorkQueue.h"
+#include "PreviewRenderer.h"
+#include "TimestepController.h"
+#include "SceneGeneration.h"
 
 // Use the namespaces of Chrono
 using namespace chrono;
@@ -29,229 +37,201 @@ using namespace irr::io;
 using namespace irr::gui;
 
 
-Scene create_scene(ChSystemNSC& mphysicalSystem, ObjectLibrary scenesLibrary, std::default_random_engine& randomEngine)
-{
-    Scene scene;
-    scene.AddLayout(mphysicalSystem, scenesLibrary, randomEngine, false);
-    scene.AddGround(mphysicalSystem);
-
-    return scene;
-}
-
-void OutputSimulationToStream(std::ostream& outputStream, chrono::ChSystem& mphysicalSystem, std::string& layoutPath, std::vector<PlacedObject>& objects)
+// Returns false if the preview window was closed before the end of the duration
+bool runApplicationFor(ChIrrApp& application, PreviewRenderer& preview, double duration, Scene& scene, BodyCuller& culler, PhysicsTelemetry& telemetry,
+    TimestepController& controller)
 {
-    auto collision_checker = chrono_types::make_shared<CheckCollisions>();
-    mphysicalSystem.GetContactContainer()->ReportAllContacts(collision_checker);
-
-    outputStream << "layout_file:" << layoutPath << std::endl;
-    for (auto object : objects)
+    ChSystem& mphysicalSystem = *application.GetSystem();
+    // Half of the smallest step of tolerance, so that accumulated rounding errors do not add an extra step
+    double endTime = mphysicalSystem.GetChTime() + duration;
+    while (mphysicalSystem.GetChTime() < endTime - 0.5 * controller.MinStep)
     {
-        PlacedObject& this_object = object;
-        std::shared_ptr<ChBody>body = this_object.CollisionBody;
-        ChContactable* a_contact = body->GetCollisionModel()->GetContactable();
-        if (collision_checker->contacts[a_contact])
-        {
-            std::cout << "Body in bad contact" << this_object.BaseObject.AssociatedFile << std::endl;
-            continue;
-        }
-        ChMatrix33<> myRot = body->Amatrix;
-        ChVector<>   mypos = body->GetPos();
-        if (mypos[1] < -7)
-        {
-            std::cout << "Body below threshold" << this_object.BaseObject.AssociatedFile << std::endl;
-            continue;
-        }
-        ChVector<> speed = body->GetPos_dt();
-        if (speed.Length() > 1.0)
-        {
-            std::cout << "Body still moving" << this_object.BaseObject.AssociatedFile << std::endl;
-            std::cout << "Speed" << speed.Length() << std::endl;
-            continue;
-        }
-        ChVector<> rot = body->GetWvel_loc();
-        if (rot.Length() > 2.0)
-        {
-            std::cout << "Body still spinning" << this_object.BaseObject.AssociatedFile << std::endl;
-            std::cout << "Rot" << rot.Length() << std::endl;
-            continue;
-        }
-        outputStream << this_object.BaseObject.AssociatedFile << std::endl;
-        outputStream << this_object.BaseObject.Wnids << std::endl;
-        outputStream << this_object.Scale << std::endl;
-        outputStream << myRot(0) << " " << myRot(1) << " " << myRot(2) << " " << mypos[0] << std::endl;
-        outputStream << myRot(3) << " " << myRot(4) << " " << myRot(5) << " " << mypos[1] << std::endl;
-        outputStream << myRot(6) << " " << myRot(7) << " " << myRot(8) << " " << mypos[2] << std::endl;
+        application.SetTimestep(chooseStep(mphysicalSystem, endTime, controller));
+        telemetry.BeginStep();
+        application.DoStep();
+        telemetry.EndStep(mphysicalSystem);
+        controller.OnStep(mphysicalSystem, telemetry.GetLastStep());
+        culler.OnStep(mphysicalSystem, scene);
 
-        std::cout << "Adding " << this_object.BaseObject.AssociatedFile << " at x:" << mypos[0] << " y:" << mypos[1] << " z:" << mypos[2] << std::endl;
+        if (!preview.OnStep())
+            return false;
     }
+    return true;
 }
 
-void removeBadContactObjects(chrono::ChSystem& mphysicalSystem, Scene& scene)
+// Returns false if the preview window was closed before the scene was complete
+bool runScenePhases(ChSystemNSC& mphysicalSystem, ChIrrApp& application, PreviewRenderer& preview, Scene& scene,
+    ObjectLibrary& library, std::mt19937& randomEngine, BodyCuller& culler, PhysicsTelemetry& telemetry, TimestepController& controller)
 {
-    auto collision_checker = chrono_types::make_shared<CheckCollisions>();
-    mphysicalSystem.GetContactContainer()->ReportAllContacts(collision_checker);
-
-    std::vector<chrono::ChContactable*> toIgnore;
-
-    for (int i = scene.MovingObjects.size() - 1; i > -1; i--)
+    for (int i = 0; i < 10; i++)
     {
-        std::shared_ptr<chrono::ChBody> currentObject = scene.MovingObjects[i].CollisionBody;
-        ChContactable* contact = currentObject->GetCollisionModel()->GetContactable();
-        if (collision_checker->contacts[contact])
-        {
-            if (!(std::find(toIgnore.begin(), toIgnore.end(), contact) != toIgnore.end()))
-            {
-                toIgnore.push_back(collision_checker->linkedContactable[contact]);
-                std::cout << "Removing from scene due to bad contact " << scene.MovingObjects[i].BaseObject.AssociatedFile << std::endl;
-                mphysicalSystem.RemoveBody(currentObject);
-                scene.MovingObjects.erase(scene.MovingObjects.begin() + i);
-            }
-            else
-            {
-                std::cout << "Uping due to bad contact " << scene.MovingObjects[i].BaseObject.AssociatedFile << std::endl;
-                currentObject->RemoveAllForces();
-                chrono::Vector currentPos = currentObject->GetPos();
-                currentObject->SetPos(chrono::Vector(currentPos[0], currentPos[1] + 0.1, currentPos[2]));
-            }
-        }
+        if (!runApplicationFor(application, preview, 0.5, scene, culler, telemetry, controller))
+            return false;
+        removeBadContactObjects(mphysicalSystem, scene);
     }
-}
 
-void runApplicationFor(ChIrrApp& application, int numberOfStep)
-{
-    for (int i = 0; i < numberOfStep; i++)
+    scene.ExtractSupportSurfaces();
+    std::cout << "Adding small objects" << std::endl;
+    telemetry.SetPhase("small_objects");
+    scene.AddSmallObjects(mphysicalSystem, library, randomEngine, (int)scene.GetSceneArea() * 2, true);
+    if (!runApplicationFor(application, preview, 0.04, scene, culler, telemetry, controller))
+        return false;
+    removeBadContactObjects(mphysicalSystem, scene);
+
+    for (int i = 0; i < 9; i++)
     {
-        application.BeginScene(true, true, SColor(255, 140, 161, 192));
+        if (!runApplicationFor(application, preview, 0.5, scene, culler, telemetry, controller))
+            return false;
+        removeBadContactObjects(mphysicalSystem, scene);
+    }
 
-        tools::drawGrid(application.GetVideoDriver(), 5, 5, 20, 20,
-            ChCoordsys<>(ChVector<>(0, 0.04, 0), Q_from_AngAxis(CH_C_PI / 2, VECT_X)),
-            video::SColor(50, 90, 90, 150), true);
+    std::cout << "Adding scene" << std::endl;
+    telemetry.SetPhase("layout_insertion");
+    mphysicalSystem.AddBody(scene.SceneLayout);
+    controller.Restart();
 
-        application.DrawAll();
+    if (!runApplicationFor(application, preview, controller.GetStep(), scene, culler, telemetry, controller))
+        return false;
+    removeBadContactObjects(mphysicalSystem, scene);
 
-        application.DoStep();
-
-        application.EndScene();
-    }
+    return runApplicationFor(application, preview, 0.25, scene, culler, telemetry, controller);
 }
 
 int main(int argc, char* argv[]) 
 {
     // Create a ChronoENGINE physical system
     ChSystemNSC mphysicalSystem;
+    configure_system(mphysicalSystem);
     std::random_device rd;
     std::mt19937 randomEngine(rd());
 
     ObjectLibrary scenesLibrary("PathTO\\SceneNetRGBD_Layouts-master\\office\\", "PathTO\\scene_description.txt",
         "PathTO\\scene_probability.txt");
-    Scene scene = create_scene(mphysicalSystem, scenesLibrary, randomEngine);
-
     ObjectLibrary library("PathTO\\ShapeNet\\", "PathTO\\library_description.txt",
         "PathTO\\large_object_probability.txt",
         "PathTO\\small_object_probability.txt");
-    scene.AddLargeObjects(mphysicalSystem, library, randomEngine, (int)scene.GetSceneArea() / 2.0);
 
+    bool visualisation = true;
+    // Visualisation only : a frame is drawn every previewRenderInterval steps, or at previewFramesPerSecond on the wall clock if 0
+    int previewRenderInterval = 0;
+    double previewFramesPerSecond = 30.0;
+    // Headless only : number of small objects variants forked from the same settled large objects
+    int numberOfVariants = 4;
+    // Headless single scene with a fixed datasetSeed only : the settled large objects are read from checkpointPath_[seed] if it exists,
+    // else they are simulated and saved there. Work queues keep their checkpoints in the queue directory.
+    std::string checkpointPath = "CheckpointPath";
+    // Headless only : if true, a post processed point cloud is written next to each output
+    bool generatePointClouds = true;
+    // Headless only : if not empty (or given as first argument), scenes are pulled from the work queue in this directory, shared between
+    // any number of generator processes, and written to its outputs subdirectory. Else a single scene is generated.
+    std::string queueDirectory = argc > 1 ? argv[1] : "";
+    // Work queue only : number of scenes of the dataset, used by the first worker which creates the queue
+    int numberOfScenes = 1000;
+    // Headless only : if not empty, scenes whose seed, settings and drawn library entries are unchanged are copied from this cache instead of generated
+    std::string resultCacheDirectory = "";
+    // Headless only : seed of the single scene, or base seed of a new work queue. Random if 0, which makes the result cache useless.
+    unsigned int datasetSeed = 0;
+    // If not empty, the welding of this mesh is compared to RepairDuplicateVertexes, and nothing else is done
+    std::string benchmarkMeshPath = "";
+    // If not empty, the simulation of small library objects falling on this layout is timed with its full mesh and with its proxy collision,
+    // and nothing else is done. The objects are drawn from datasetSeed (random if 0).
+    std::string benchmarkLayoutPath = "";
+
+    if (!benchmarkMeshPath.empty())
+    {
+        Scene::MeshLoader.Benchmark(benchmarkMeshPath, std::cout);
+        return 0;
+    }
+    if (!benchmarkLayoutPath.empty())
+    {
+        benchmark_layout_proxy(benchmarkLayoutPath, library, datasetSeed ? datasetSeed : rd(), 100, 2.0, std::cout);
+        return 0;
+    }
 
-    auto solver = chrono_types::make_shared<ChSolverPSOR>();
-    solver->SetMaxIterations(40);
-    solver->EnableWarmStart(true);
-    mphysicalSystem.SetSolver(solver);
-
-    mphysicalSystem.SetMaxPenetrationRecoverySpeed(2.0);
-    mphysicalSystem.SetMinBounceSpeed(50.0);
+    // Without visualisation, no visual asset is built
+    Scene::Headless = !visualisation;
 
-    bool visualisation = true;
     // Simulation loop
 
     if (visualisation)
     {
+        Scene scene = create_scene(mphysicalSystem, scenesLibrary, randomEngine);
+        scene.AddLargeObjects(mphysicalSystem, library, randomEngine, (int)scene.GetSceneArea() / 2.0);
+        BodyCuller culler;
+        PhysicsTelemetry telemetry;
+        telemetry.SetPhase("large_objects");
+
         // Create the Irrlicht visualization
         ChIrrApp application(&mphysicalSystem, L"Scene creation", core::dimension2d<u32>(800, 600));
         application.AddTypicalLogo();
         application.AddTypicalSky();
         application.AddTypicalLights(core::vector3df(70.f, 120.f, -90.f), core::vector3df(30.f, 80.f, 60.f), 290, 190);
         application.AddTypicalCamera(core::vector3df(12, 3.5, -5), core::vector3df(0, 3, 0));
-        // Add a ChIrrNodeAsset to all items
-        application.AssetBindAll();
-
-        // Convert meshes into visible meshes
-        application.AssetUpdateAll();
-        double timeStep = 0.02;
-        application.SetTimestep(timeStep);
-        application.SetTryRealtime(true);
-
-        while (application.GetDevice()->run())
-        {
-            runApplicationFor(application, 0.5 / timeStep);
-            //system("pause");
-            removeBadContactObjects(mphysicalSystem, scene);
-            application.AssetBindAll();
-            application.AssetUpdateAll();
-
-            for (int i = 0; i < 9; i++)
-            {
-                runApplicationFor(application, 0.5 / timeStep);
-                removeBadContactObjects(mphysicalSystem, scene);
-                application.AssetBindAll();
-                application.AssetUpdateAll();
-            }
-
-            std::cout << "Adding small objects" << std::endl;
-            scene.AddSmallObjects(mphysicalSystem, library, randomEngine, (int)scene.GetSceneArea() * 2, true);
-            application.AssetBindAll();
-            application.AssetUpdateAll();
-            runApplicationFor(application, 0.04 / timeStep);
-            //system("pause");
-            removeBadContactObjects(mphysicalSystem, scene);
-            application.AssetBindAll();
-            application.AssetUpdateAll();
-
-            for (int i = 0; i < 9; i++)
-            {
-                runApplicationFor(application, 0.5 / timeStep);
-                removeBadContactObjects(mphysicalSystem, scene);
-                application.AssetBindAll();
-                application.AssetUpdateAll();
-            }
-
-            std::cout << "Adding scene" << std::endl;
-            mphysicalSystem.AddBody(scene.SceneLayout);
-            application.AssetBindAll();
-            application.AssetUpdateAll();
+        TimestepController controller(mphysicalSystem.GetStep());
+        // Bind the bodies already in the system, the following ones are bound as they are added
+        PreviewRenderer preview(application, previewRenderInterval, previewFramesPerSecond);
+        preview.Synchronize();
 
-            runApplicationFor(application, 1);
-            removeBadContactObjects(mphysicalSystem, scene);
-            application.AssetBindAll();
-            application.AssetUpdateAll();
+        bool completed = application.GetDevice()->run() && runScenePhases(mphysicalSystem, application, preview, scene, library, randomEngine, culler, telemetry, controller);
 
-            runApplicationFor(application, 0.25 / timeStep);
+        culler.PrintReport(std::cout);
+        controller.PrintReport(std::cout);
+        telemetry.PrintReport(std::cout);
+        preview.PrintReport(std::cout);
 
-            break;
+        // An interrupted scene is not settled, it must not be mistaken for a result
+        if (completed)
+        {
+            std::ofstream outputStream("OutputPath");
+            OutputSimulationToStream(outputStream, mphysicalSystem, scene.UsedLayout.AssociatedFile, scene.MovingObjects);
+            outputStream.close();
         }
+        else
+            std::cout << "Preview closed, no output written" << std::endl;
     }
-    else
+    else if (queueDirectory.empty())
     {
-        std::cout << "Beginning simulation" << std::endl;
-        mphysicalSystem.SetStep(0.02);
-
-        mphysicalSystem.DoEntireDynamics(0.04);
-        removeBadContactObjects(mphysicalSystem, scene);
-        mphysicalSystem.DoEntireDynamics(5.0);
-
-        std::cout << "Mid simulation processing" << std::endl;
-        mphysicalSystem.AddBody(scene.SceneLayout);
-
-        removeBadContactObjects(mphysicalSystem, scene);
-        mphysicalSystem.DoEntireDynamics(0.02);
-        removeBadContactObjects(mphysicalSystem, scene);
-        mphysicalSystem.DoEntireDynamics(0.25);
-
+        PhysicsTelemetry telemetry;
+        PointCloudProcessor pointCloudProcessor;
+        std::unique_ptr<ResultCache> cache = open_result_cache(resultCacheDirectory, scenesLibrary, library, numberOfVariants, generatePointClouds ? &pointCloudProcessor : nullptr);
+        // The checkpoint is keyed by the seed, a checkpoint of another scene must not be reused. A random seed is never drawn again,
+        // its checkpoint would only be left behind.
+        unsigned int seed = datasetSeed ? datasetSeed : rd();
+        generate_scene(scenesLibrary, library, seed, datasetSeed ? checkpointPath + "_" + std::to_string(seed) : "", "OutputPath", numberOfVariants,
+            generatePointClouds ? &pointCloudProcessor : nullptr, telemetry, cache.get());
+
+        telemetry.PrintReport(std::cout);
+        if (cache)
+            cache->PrintReport(std::cout);
         std::cout << "Simulation ended" << std::endl;
     }
+    else
+    {
+        WorkQueue queue(queueDirectory);
+        if (!queue.Open(numberOfScenes, datasetSeed ? datasetSeed : rd()))
+            return 1;
+
+        PhysicsTelemetry telemetry;
+        PointCloudProcessor pointCloudProcessor;
+        std::unique_ptr<ResultCache> cache = open_result_cache(resultCacheDirectory, scenesLibrary, library, numberOfVariants, generatePointClouds ? &pointCloudProcessor : nullptr);
+        int sceneIndex;
+        while (queue.ClaimNext(sceneIndex))
+        {
+            std::cout << "Worker " << queue.WorkerId << " generating scene " << sceneIndex << std::endl;
+            // Outputs are written in the staging directory, and only published once the whole scene is done. The checkpoint is kept
+            // out of it, so that it is not published and a worker taking over an expired lease can resume from it.
+            std::string stagingPath = queue.GetStagingDirectory(sceneIndex) + "/scene_" + std::to_string(sceneIndex);
+            generate_scene(scenesLibrary, library, queue.GetSceneSeed(sceneIndex), queue.GetCheckpointPath(sceneIndex), stagingPath + "_", numberOfVariants,
+                generatePointClouds ? &pointCloudProcessor : nullptr, telemetry, cache.get());
+            queue.Complete(sceneIndex);
+            queue.PrintReport(std::cout);
+        }
 
-    std::ofstream outputStream("OutputPath");
-    OutputSimulationToStream(outputStream, mphysicalSystem, scene.UsedLayout.AssociatedFile, scene.MovingObjects);
-    outputStream.close();
+        telemetry.PrintReport(std::cout);
+        if (cache)
+            cache->PrintReport(std::cout);
+        std::cout << "No scene left in " << queueDirectory << std::endl;
+    }
 
     return 0;
 }
\ No newline at end of file
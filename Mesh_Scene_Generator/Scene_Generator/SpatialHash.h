@@ -0,0 +1,104 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+
+/// <summary>
+/// Marks the free slots of the cell maps, cell keys only use 63 bits
+/// </summary>
+const uint64_t EmptyCellKey = ~0ull;
+
+/// <summary>
+/// Key of a cell of a regular grid, 21 bits per axis (enough for +/- 10 km with 1 cm cells).
+/// Cells further apart can share a key, the users test the distances anyway.
+/// </summary>
+inline uint64_t GetCellKey(int64_t i, int64_t j, int64_t k)
+{
+	const int64_t offset = 1 << 20;
+	return ((uint64_t)(i + offset) & 0x1FFFFF) | (((uint64_t)(j + offset) & 0x1FFFFF) << 21) | (((uint64_t)(k + offset) & 0x1FFFFF) << 42);
+}
+
+/// <summary>
+/// Open addressing map from cell keys to indices, much lighter than std::unordered_map for millions of cells
+/// </summary>
+class CellMap
+{
+public:
+	/// <param name="expectedSize">Number of keys expected, the map grows beyond it</param>
+	CellMap(size_t expectedSize)
+	{
+		size_t capacity = 16;
+		while (capacity < 2 * expectedSize)
+			capacity *= 2;
+		Keys.assign(capacity, EmptyCellKey);
+		Values.resize(capacity);
+		Mask = capacity - 1;
+		Size = 0;
+	}
+
+	/// <summary>
+	/// Index associated to the key, the given value is associated first if the key is absent
+	/// </summary>
+	uint32_t Insert(uint64_t key, uint32_t value, bool& inserted)
+	{
+		size_t slot = GetSlot(key);
+		while (Keys[slot] != EmptyCellKey && Keys[slot] != key)
+			slot = (slot + 1) & Mask;
+		inserted = Keys[slot] == EmptyCellKey;
+		if (inserted)
+		{
+			Keys[slot] = key;
+			Values[slot] = value;
+			// Load factor kept under one half, so that probe sequences stay short
+			if (++Size * 2 > Keys.size())
+				Grow();
+			return value;
+		}
+		return Values[slot];
+	}
+
+	/// <summary>
+	/// Index associated to the key, -1 if absent
+	/// </summary>
+	int64_t Find(uint64_t key) const
+	{
+		size_t slot = GetSlot(key);
+		while (Keys[slot] != EmptyCellKey)
+		{
+			if (Keys[slot] == key)
+				return Values[slot];
+			slot = (slot + 1) & Mask;
+		}
+		return -1;
+	}
+
+private:
+	void Grow()
+	{
+		std::vector<uint64_t> keys(Keys.size() * 2, EmptyCellKey);
+		std::vector<uint32_t> values(Keys.size() * 2);
+		Mask = keys.size() - 1;
+		for (size_t i = 0; i < Keys.size(); i++)
+		{
+			if (Keys[i] == EmptyCellKey)
+				continue;
+			size_t slot = GetSlot(Keys[i]);
+			while (keys[slot] != EmptyCellKey)
+				slot = (slot + 1) & Mask;
+			keys[slot] = Keys[i];
+			values[slot] = Values[i];
+		}
+		Keys.swap(keys);
+		Values.swap(values);
+	}
+
+	size_t GetSlot(uint64_t key) const
+	{
+		uint64_t hash = key * 0xFF51AFD7ED558CCDull;
+		return (size_t)(hash ^ (hash >> 29)) & Mask;
+	}
+
+	std::vector<uint64_t> Keys;
+	std::vector<uint32_t> Values;
+	size_t Mask;
+	size_t Size;
+};
@@ -0,0 +1,127 @@
+#include "SupportSurfaceIndex.h"
+#include <algorithm>
+#include <cmath>
+
+
+SupportSurfaceIndex::SupportSurfaceIndex(double cellSize)
+{
+    CellSize = cellSize;
+}
+
+void SupportSurfaceIndex::Clear()
+{
+    Patches.clear();
+    CumulativeArea.clear();
+    Cells.clear();
+}
+
+long long SupportSurfaceIndex::GetCellKey(int i, int k)
+{
+    // Shifted as unsigned, left shifting a negative index is undefined
+    return (long long)(((unsigned long long)(unsigned int)i << 32) | (unsigned long long)(unsigned int)k);
+}
+
+int SupportSurfaceIndex::AddMesh(std::shared_ptr<chrono::geometry::ChTriangleMeshConnected> mesh, std::shared_ptr<chrono::ChBody> body, double minNormalY, double minHeight)
+{
+    std::vector<chrono::ChVector<double>>& vertices = mesh->getCoordsVertices();
+    std::vector<chrono::ChVector<int>>& faces = mesh->getIndicesVertexes();
+
+    int addedPatches = 0;
+    for (auto& face : faces)
+    {
+        chrono::Vector a = body->TransformPointLocalToParent(vertices[face[0]]);
+        chrono::Vector b = body->TransformPointLocalToParent(vertices[face[1]]);
+        chrono::Vector c = body->TransformPointLocalToParent(vertices[face[2]]);
+
+        chrono::Vector normal = Vcross(b - a, c - a);
+        double doubleArea = normal.Length();
+        if (doubleArea < 1e-10)
+            continue;
+        // Vertical axis is y, as for the gravity of the engine
+        if (normal[1] / doubleArea < minNormalY)
+            continue;
+        if (std::min({ a[1], b[1], c[1] }) < minHeight)
+            continue;
+
+        SupportPatch patch = { a, b, c, 0.5 * doubleArea };
+        int patchIndex = (int)Patches.size();
+        Patches.push_back(patch);
+        CumulativeArea.push_back((CumulativeArea.size() == 0 ? 0.0 : CumulativeArea.back()) + patch.Area);
+
+        // The patch is referenced in every cell overlapped by its bounding box
+        int imin = (int)std::floor(std::min({ a[0], b[0], c[0] }) / CellSize);
+        int imax = (int)std::floor(std::max({ a[0], b[0], c[0] }) / CellSize);
+        int kmin = (int)std::floor(std::min({ a[2], b[2], c[2] }) / CellSize);
+        int kmax = (int)std::floor(std::max({ a[2], b[2], c[2] }) / CellSize);
+        for (int i = imin; i <= imax; i++)
+            for (int k = kmin; k <= kmax; k++)
+                Cells[GetCellKey(i, k)].push_back(patchIndex);
+
+        addedPatches++;
+    }
+
+    return addedPatches;
+}
+
+double SupportSurfaceIndex::GetTotalArea()
+{
+    return CumulativeArea.size() == 0 ? 0.0 : CumulativeArea.back();
+}
+
+bool SupportSurfaceIndex::GetCeilingHeight(const chrono::Vector& point, double& height)
+{
+    auto cell = Cells.find(GetCellKey((int)std::floor(point[0] / CellSize), (int)std::floor(point[2] / CellSize)));
+    if (cell == Cells.end())
+        return false;
+
+    bool found = false;
+    for (int patchIndex : cell->second)
+    {
+        SupportPatch& patch = Patches[patchIndex];
+
+        // Barycentric coordinates of the point projected on the horizontal plane
+        double d = (patch.B[2] - patch.C[2]) * (patch.A[0] - patch.C[0]) + (patch.C[0] - patch.B[0]) * (patch.A[2] - patch.C[2]);
+        if (std::abs(d) < 1e-12)
+            continue;
+        double u = ((patch.B[2] - patch.C[2]) * (point[0] - patch.C[0]) + (patch.C[0] - patch.B[0]) * (point[2] - patch.C[2])) / d;
+        double v = ((patch.C[2] - patch.A[2]) * (point[0] - patch.C[0]) + (patch.A[0] - patch.C[0]) * (point[2] - patch.C[2])) / d;
+        double w = 1.0 - u - v;
+        if (u < 0.0 || v < 0.0 || w < 0.0)
+            continue;
+
+        double patchHeight = u * patch.A[1] + v * patch.B[1] + w * patch.C[1];
+        // Small margin, so that the patch the point was drawn from is not seen as its own ceiling
+        if (patchHeight > point[1] + 1e-3 && (!found || patchHeight < height))
+        {
+            height = patchHeight;
+            found = true;
+        }
+    }
+    return found;
+}
+
+bool SupportSurfaceIndex::SamplePoint(std::default_random_engine& randomEngine, double minClearance, chrono::Vector& point)
+{
+    if (Patches.size() == 0)
+        return false;
+
+    std::uniform_real_distribution<double> areaDistribution(0.0, CumulativeArea.back());
+    std::uniform_real_distribution<double> barycentricDistribution(0.0, 1.0);
+
+    // Points covered by another surface (eg : the lower shelf of a bookshelf) are drawn again a few times
+    for (int attempt = 0; attempt < 10; attempt++)
+    {
+        int patchIndex = (int)(std::upper_bound(CumulativeArea.begin(), CumulativeArea.end(), areaDistribution(randomEngine)) - CumulativeArea.begin());
+        patchIndex = std::min(patchIndex, (int)Patches.size() - 1);
+        SupportPatch& patch = Patches[patchIndex];
+
+        double r1 = std::sqrt(barycentricDistribution(randomEngine));
+        double r2 = barycentricDistribution(randomEngine);
+        point = patch.A * (1.0 - r1) + patch.B * (r1 * (1.0 - r2)) + patch.C * (r1 * r2);
+
+        double ceiling;
+        if (!GetCeilingHeight(point, ceiling) || ceiling - point[1] > minClearance)
+            return true;
+    }
+    return false;
+}
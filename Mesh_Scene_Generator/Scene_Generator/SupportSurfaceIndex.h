@@ -0,0 +1,93 @@
+#pragma once
+#include <vector>
+#include <random>
+#include <unordered_map>
+#include "chrono/physics/ChBody.h"
+#include "chrono/geometry/ChTriangleMeshConnected.h"
+
+/// <summary>
+/// A roughly horizontal, upward facing triangle extracted from a settled object, on which small objects can be spawned
+/// </summary>
+struct SupportPatch
+{
+	/// <summary>
+	/// Triangle vertices, in the world frame
+	/// </summary>
+	chrono::Vector A, B, C;
+	/// <summary>
+	/// Area of the triangle (m2), used as its sampling weight
+	/// </summary>
+	double Area;
+};
+
+/// <summary>
+/// Spatial index of the support surfaces of a scene, used to spawn small objects on top of the settled large objects
+/// </summary>
+class SupportSurfaceIndex
+{
+public:
+	/// <summary>
+	/// Build an empty index
+	/// </summary>
+	/// <param name="cellSize">Size (m) of the horizontal grid cells used to index the patches</param>
+	SupportSurfaceIndex(double cellSize = 0.25);
+	/// <summary>
+	/// Remove every patch from the index
+	/// </summary>
+	void Clear();
+	/// <summary>
+	/// Extract the support patches of a posed mesh and add them to the index
+	/// </summary>
+	/// <param name="mesh">The mesh, in the body frame</param>
+	/// <param name="body">The body giving the current pose of the mesh</param>
+	/// <param name="minNormalY">Minimum vertical component of a triangle normal for it to be considered horizontal</param>
+	/// <param name="minHeight">Patches under this height (m) are ignored (eg : the bottom of a chair leg)</param>
+	/// <returns>The number of patches added</returns>
+	int AddMesh(std::shared_ptr<chrono::geometry::ChTriangleMeshConnected> mesh, std::shared_ptr<chrono::ChBody> body, double minNormalY, double minHeight);
+	/// <summary>
+	/// Draw a random point on the support surfaces, each patch being weighted by its area
+	/// </summary>
+	/// <param name="randomEngine">Random engine used for the draw</param>
+	/// <param name="minClearance">Minimum free height (m) above the point, points under another patch closer than this are rejected</param>
+	/// <param name="point">The drawn point, in the world frame</param>
+	/// <returns>False if no valid point could be found</returns>
+	bool SamplePoint(std::default_random_engine& randomEngine, double minClearance, chrono::Vector& point);
+	/// <summary>
+	/// Give the height of the lowest patch located above a point
+	/// </summary>
+	/// <param name="point">Point (world frame) from which to look upward</param>
+	/// <param name="height">The height of the patch found</param>
+	/// <returns>False if there is no patch above the point</returns>
+	bool GetCeilingHeight(const chrono::Vector& point, double& height);
+	/// <summary>
+	/// Number of patches in the index
+	/// </summary>
+	size_t Size() { return Patches.size(); }
+	/// <summary>
+	/// Total area of the indexed patches (m2)
+	/// </summary>
+	double GetTotalArea();
+
+private:
+	/// <summary>
+	/// Key of the grid cell of indices (i, k) along the x and z axis
+	/// </summary>
+	long long GetCellKey(int i, int k);
+
+public:
+	/// <summary>
+	/// Every indexed patch
+	/// </summary>
+	std::vector<SupportPatch> Patches;
+
+private:
+	double CellSize;
+	/// <summary>
+	/// Cumulative area of the patches, used for the weighted draw
+	/// </summary>
+	std::vector<double> CumulativeArea;
+	/// <summary>
+	/// Patches overlapping each grid cell of the horizontal plane
+	/// </summary>
+	std::unordered_map<long long, std::vector<int>> Cells;
+};
@@ -0,0 +1,100 @@
+#include "TimestepController.h"
+#include <algorithm>
+#include <cmath>
+
+
+TimestepController::TimestepController(double initialStep, double minStep, double maxStep)
+{
+    MinStep = minStep;
+    MaxStep = std::max(minStep, maxStep);
+    Step = std::min(std::max(initialStep, MinStep), MaxStep);
+    ReferenceStep = initialStep;
+    GrowthFactor = 1.2;
+    ShrinkFactor = 0.5;
+    MaxTravel = 0.1;
+    MaxPenetration = -0.05;
+    ContactJumpFraction = 0.25;
+    ContactJumpMinimum = 20;
+    PreviousContacts = 0;
+    PreviousDeepest = 0.0;
+    PreviousDeepPenetrations = 0;
+    Steps = 0;
+    SimulatedTime = 0.0;
+    SmallestStep = Step;
+    LargestStep = Step;
+    PenetrationShrinks = 0;
+    ContactShrinks = 0;
+    TravelCaps = 0;
+}
+
+double TimestepController::GetStep()
+{
+    return Step;
+}
+
+void TimestepController::OnStep(chrono::ChSystem& mphysicalSystem, const StepSample& step)
+{
+    double lastStep = mphysicalSystem.GetStep();
+    Steps++;
+    SimulatedTime += lastStep;
+    SmallestStep = std::min(SmallestStep, lastStep);
+    LargestStep = std::max(LargestStep, lastStep);
+
+    // A deep contact the solver is already pushing out does not need a smaller step, only one getting deeper or a new one does
+    bool penetrationGrew = false;
+    if (step.DeepPenetrations >= 0)
+    {
+        penetrationGrew = step.DeepestContact < MaxPenetration
+            && (step.DeepestContact < PreviousDeepest || step.DeepPenetrations > PreviousDeepPenetrations);
+        PreviousDeepest = step.DeepestContact;
+        PreviousDeepPenetrations = step.DeepPenetrations;
+    }
+    int contacts = step.Contacts;
+
+    if (penetrationGrew)
+    {
+        Step *= ShrinkFactor;
+        PenetrationShrinks++;
+    }
+    else if (contacts > PreviousContacts * (1.0 + ContactJumpFraction) && contacts - PreviousContacts >= ContactJumpMinimum)
+    {
+        Step *= ShrinkFactor;
+        ContactShrinks++;
+    }
+    else
+        Step *= GrowthFactor;
+    PreviousContacts = contacts;
+
+    double maxSpeed2 = 0.0;
+    for (auto& body : mphysicalSystem.Get_bodylist())
+    {
+        if (!body->GetBodyFixed() && !body->GetSleeping())
+            maxSpeed2 = std::max(maxSpeed2, body->GetPos_dt().Length2());
+    }
+    if (maxSpeed2 * Step * Step > MaxTravel * MaxTravel)
+    {
+        Step = MaxTravel / std::sqrt(maxSpeed2);
+        TravelCaps++;
+    }
+
+    Step = std::min(std::max(Step, MinStep), MaxStep);
+}
+
+void TimestepController::Restart()
+{
+    Step = MinStep;
+    PreviousDeepest = 0.0;
+    PreviousDeepPenetrations = 0;
+}
+
+void TimestepController::PrintReport(std::ostream& outputStream)
+{
+    outputStream << "Timestep : " << Steps << " steps for " << SimulatedTime << " s";
+    if (ReferenceStep > 0.0)
+        outputStream << " (" << std::ceil(SimulatedTime / ReferenceStep - 1e-6) << " with the fixed " << ReferenceStep << " s step)";
+    if (Steps > 0)
+        outputStream << ", mean " << SimulatedTime / Steps << " s, min " << SmallestStep << " s, max " << LargestStep << " s";
+    outputStream << std::endl;
+    outputStream << "  shrunk for penetration : " << PenetrationShrinks << ", for contact jumps : " << ContactShrinks
+        << ", capped by body speed : " << TravelCaps << std::endl;
+}
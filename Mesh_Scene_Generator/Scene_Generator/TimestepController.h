@@ -0,0 +1,88 @@
+#pragma once
+#include <memory>
+#include <ostream>
+#include "chrono/physics/ChSystem.h"
+#include "PhysicsTelemetry.h"
+
+/// <summary>
+/// Step size controller : the step grows while the scene is calm (free fall, resting bodies) and shrinks when contacts get violent.
+/// After each step, the step is
+///  - shrunk if a penetration beyond MaxPenetration got deeper or new ones appeared, or if the number of contacts jumped (new impacts),
+///  - grown otherwise,
+///  - capped so that the fastest body does not travel more than MaxTravel in one step, to avoid tunnelling,
+///  - kept within [MinStep, MaxStep].
+/// The penetrations are read from the contacts walk the telemetry samples periodically, the contacts are not walked at each step.
+/// With MinStep equal to MaxStep, the simulation uses a fixed step.
+/// </summary>
+class TimestepController
+{
+public:
+	/// <summary>
+	/// Build a controller
+	/// </summary>
+	/// <param name="initialStep">First step size (s), also the fixed step the number of steps is compared to in the report</param>
+	/// <param name="minStep">Smallest step size (s)</param>
+	/// <param name="maxStep">Largest step size (s)</param>
+	TimestepController(double initialStep = 0.02, double minStep = 0.0025, double maxStep = 0.04);
+	/// <summary>
+	/// Size of the next step (s)
+	/// </summary>
+	double GetStep();
+	/// <summary>
+	/// To be called after each simulation step, to choose the size of the next one
+	/// </summary>
+	/// <param name="mphysicalSystem">The physical engine which did the step</param>
+	/// <param name="step">Counters of the step, as recorded by the telemetry</param>
+	void OnStep(chrono::ChSystem& mphysicalSystem, const StepSample& step);
+	/// <summary>
+	/// Drop to the smallest step, before an event which creates many contacts at once (e.g. the insertion of the layout)
+	/// </summary>
+	void Restart();
+	/// <summary>
+	/// Write the number of steps compared to the fixed initial step, their sizes and the reasons of the step reductions
+	/// </summary>
+	void PrintReport(std::ostream& outputStream);
+
+public:
+	double MinStep;
+	double MaxStep;
+	/// <summary>
+	/// Step multiplier when the scene is calm
+	/// </summary>
+	double GrowthFactor;
+	/// <summary>
+	/// Step multiplier when the contacts get violent
+	/// </summary>
+	double ShrinkFactor;
+	/// <summary>
+	/// Largest distance (m) a body may travel in one step
+	/// </summary>
+	double MaxTravel;
+	/// <summary>
+	/// Penetration (m, negative) beyond which a deepening contact shrinks the step, the bad contact threshold of CheckCollisions.
+	/// New deep contacts are those counted beyond PhysicsTelemetry::PenetrationThreshold, which should be the same.
+	/// </summary>
+	double MaxPenetration;
+	/// <summary>
+	/// The step is shrunk when the number of contacts grows by more than this fraction (and ContactJumpMinimum contacts) in one step
+	/// </summary>
+	double ContactJumpFraction;
+	int ContactJumpMinimum;
+
+private:
+	double Step;
+	double ReferenceStep;
+	int PreviousContacts;
+	/// <summary>
+	/// Deepest contact and number of deep contacts at the previous sampled step
+	/// </summary>
+	double PreviousDeepest;
+	int PreviousDeepPenetrations;
+	long long Steps;
+	double SimulatedTime;
+	double SmallestStep;
+	double LargestStep;
+	long long PenetrationShrinks;
+	long long ContactShrinks;
+	long long TravelCaps;
+};
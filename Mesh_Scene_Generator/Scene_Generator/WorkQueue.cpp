@@ -0,0 +1,370 @@
+#include "WorkQueue.h"
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <random>
+#include <vector>
+#include <chrono>
+#include <cstdlib>
+#include <algorithm>
+#include <iostream>
+#include "Log.h"
+
+namespace fs = std::filesystem;
+
+
+namespace
+{
+    // Wall clock time, shared by the nodes (which are expected to be synchronized)
+    int64_t GetTime()
+    {
+        return (int64_t)std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+    }
+
+    // Write a whole file, so that readers never see it partially written
+    bool WriteFileAtomically(const fs::path& filePath, const std::string& content, const std::string& workerId)
+    {
+        fs::path temporaryPath = filePath;
+        temporaryPath += ".tmp." + workerId;
+        {
+            std::ofstream outputStream(temporaryPath);
+            outputStream << content;
+            if (!outputStream.good())
+                return false;
+        }
+        std::error_code error;
+        fs::rename(temporaryPath, filePath, error);
+        if (error)
+            fs::remove(temporaryPath, error);
+        return !error;
+    }
+
+    // Create a whole file if it does not exist yet : the hard link fails instead of replacing a file created by another worker.
+    // Returns false if the file still does not exist.
+    bool CreateFileAtomically(const fs::path& filePath, const std::string& content, const std::string& workerId)
+    {
+        fs::path temporaryPath = filePath;
+        temporaryPath += ".tmp." + workerId;
+        {
+            std::ofstream outputStream(temporaryPath);
+            outputStream << content;
+            if (!outputStream.good())
+                return false;
+        }
+        std::error_code error;
+        fs::create_hard_link(temporaryPath, filePath, error);
+        bool exists = fs::exists(filePath);
+        fs::remove(temporaryPath, error);
+        return exists;
+    }
+
+    // Indices of the scenes named by the entries of a directory (temporary and expired entries are ignored)
+    std::vector<char> ListScenes(const fs::path& directory, int numberOfScenes)
+    {
+        std::vector<char> listed(numberOfScenes, 0);
+        std::error_code error;
+        for (fs::directory_iterator entry(directory, error), end; !error && entry != end; entry.increment(error))
+        {
+            std::string name = entry->path().filename().string();
+            if (name.empty() || name.find_first_not_of("0123456789") != std::string::npos)
+                continue;
+            int sceneIndex = std::atoi(name.c_str());
+            if (sceneIndex >= 0 && sceneIndex < numberOfScenes)
+                listed[sceneIndex] = 1;
+        }
+        return listed;
+    }
+}
+
+
+WorkQueue::WorkQueue(std::string queueDirectory, double leaseDuration)
+{
+    QueueDirectory = queueDirectory;
+    LeaseDuration = leaseDuration;
+    NumberOfScenes = 0;
+    BaseSeed = 0;
+    RenewedScene = -1;
+    ClaimTime = 0;
+    StartTime = GetTime();
+    CompletedScenes = 0;
+
+    const char* hostName = std::getenv("COMPUTERNAME");
+    if (!hostName)
+        hostName = std::getenv("HOSTNAME");
+    std::random_device rd;
+    std::ostringstream workerId;
+    workerId << (hostName ? hostName : "worker") << "-" << std::hex << rd() << rd();
+    WorkerId = workerId.str();
+}
+
+WorkQueue::~WorkQueue()
+{
+    StopRenewing();
+}
+
+bool WorkQueue::Open(int numberOfScenes, unsigned int baseSeed)
+{
+    fs::path directory(QueueDirectory);
+    std::error_code error;
+    for (const char* subdirectory : { "leases", "staging", "checkpoints", "outputs", "done" })
+        fs::create_directories(directory / subdirectory, error);
+
+    // Every worker proposes a manifest, only the first one is kept. The manifest appears whole, so that a worker dying
+    // while creating it cannot leave the queue without one.
+    fs::path manifestPath = directory / "manifest.txt";
+    std::ostringstream manifest;
+    manifest << "work_queue 1" << std::endl;
+    manifest << "number_of_scenes " << numberOfScenes << std::endl;
+    manifest << "base_seed " << baseSeed << std::endl;
+    manifest << "created " << GetTime() << std::endl;
+    if (!CreateFileAtomically(manifestPath, manifest.str(), WorkerId))
+    {
+        Log::Out() << "Could not create the work queue manifest " << manifestPath.string() << std::endl;
+        return false;
+    }
+
+    std::ifstream inputStream(manifestPath);
+    std::string header, key;
+    int version;
+    if (!(inputStream >> header >> version) || header != "work_queue" || version != 1)
+    {
+        Log::Out() << "Could not read the work queue manifest " << manifestPath.string() << std::endl;
+        return false;
+    }
+    inputStream >> key >> NumberOfScenes >> key >> BaseSeed;
+    return !inputStream.fail();
+}
+
+bool WorkQueue::ClaimNext(int& sceneIndex)
+{
+    // While other workers hold the last scenes, wait in case one of them dies
+    while (true)
+    {
+        bool remainingScenes;
+        if (TryClaim(sceneIndex, remainingScenes))
+            return true;
+        if (!remainingScenes)
+            return false;
+        std::this_thread::sleep_for(std::chrono::milliseconds((int64_t)(1000.0 * std::min(30.0, LeaseDuration / 4.0))));
+    }
+}
+
+bool WorkQueue::TryClaim(int& sceneIndex, bool& remainingScenes)
+{
+    fs::path directory(QueueDirectory);
+    std::vector<char> done = ListScenes(directory / "done", NumberOfScenes);
+    std::vector<char> leased = ListScenes(directory / "leases", NumberOfScenes);
+    remainingScenes = std::find(done.begin(), done.end(), 0) != done.end();
+
+    // Free scenes first, then the ones whose lease has expired
+    for (int pass = 0; pass < 2; pass++)
+    {
+        for (int i = 0; i < NumberOfScenes; i++)
+        {
+            if (done[i] || (pass == 0) == (bool)leased[i])
+                continue;
+
+            std::error_code error;
+            fs::path leasePath = directory / "leases" / std::to_string(i);
+            if (pass == 1)
+            {
+                std::string owner;
+                bool expired;
+                if (!ReadLease(i, owner, expired) || !expired || !TakeOverLease(i, owner))
+                    continue;
+            }
+            // Creating a directory is atomic and fails if it exists, even on network filesystems
+            if (!fs::create_directory(leasePath, error))
+                continue;
+            // The scene may have been completed between the listing and the claim
+            if (fs::exists(directory / "done" / std::to_string(i), error))
+            {
+                fs::remove_all(leasePath, error);
+                continue;
+            }
+
+            WriteLease(i);
+            fs::create_directories(GetStagingDirectory(i), error);
+            ClaimTime = GetTime();
+            StartRenewing(i);
+            sceneIndex = i;
+            return true;
+        }
+    }
+    return false;
+}
+
+unsigned int WorkQueue::GetSceneSeed(int sceneIndex)
+{
+    std::seed_seq seed{ BaseSeed, (unsigned int)sceneIndex };
+    unsigned int sceneSeed;
+    seed.generate(&sceneSeed, &sceneSeed + 1);
+    return sceneSeed;
+}
+
+std::string WorkQueue::GetStagingDirectory(int sceneIndex)
+{
+    return (fs::path(QueueDirectory) / "staging" / (std::to_string(sceneIndex) + "." + WorkerId)).string();
+}
+
+std::string WorkQueue::GetCheckpointPath(int sceneIndex)
+{
+    return (fs::path(QueueDirectory) / "checkpoints" / std::to_string(sceneIndex)).string();
+}
+
+bool WorkQueue::Complete(int sceneIndex)
+{
+    StopRenewing();
+    fs::path directory(QueueDirectory);
+    std::error_code error;
+
+    std::string owner;
+    bool expired;
+    if (!ReadLease(sceneIndex, owner, expired) || owner != WorkerId)
+    {
+        Log::Out() << "Lease of scene " << sceneIndex << " lost, outputs discarded" << std::endl;
+        fs::remove_all(GetStagingDirectory(sceneIndex), error);
+        return false;
+    }
+
+    std::vector<fs::path> stagedFiles;
+    for (fs::directory_iterator entry(GetStagingDirectory(sceneIndex), error), end; !error && entry != end; entry.increment(error))
+        stagedFiles.push_back(entry->path());
+
+    // Each output appears complete or not at all, a scene generated twice (after a lease expiry) overwrites the same files
+    for (auto& stagedFile : stagedFiles)
+    {
+        fs::rename(stagedFile, directory / "outputs" / stagedFile.filename(), error);
+        if (error)
+        {
+            Log::Out() << "Could not publish " << stagedFile.string() << " : " << error.message() << std::endl;
+            return false;
+        }
+    }
+
+    std::ostringstream marker;
+    marker << WorkerId << " " << ClaimTime << " " << GetTime() << std::endl;
+    if (!WriteFileAtomically(directory / "done" / std::to_string(sceneIndex), marker.str(), WorkerId))
+        return false;
+
+    fs::remove_all(GetStagingDirectory(sceneIndex), error);
+    fs::remove(GetCheckpointPath(sceneIndex), error);
+    fs::remove_all(directory / "leases" / std::to_string(sceneIndex), error);
+    CompletedScenes++;
+    return true;
+}
+
+void WorkQueue::Release(int sceneIndex)
+{
+    StopRenewing();
+    std::error_code error;
+    fs::remove_all(GetStagingDirectory(sceneIndex), error);
+    fs::remove_all(fs::path(QueueDirectory) / "leases" / std::to_string(sceneIndex), error);
+}
+
+void WorkQueue::PrintReport(std::ostream& outputStream)
+{
+    fs::path directory(QueueDirectory);
+    std::error_code error;
+    int doneScenes = 0;
+    int64_t firstClaim = 0, lastCompletion = 0;
+    std::vector<std::string> workers;
+    for (fs::directory_iterator entry(directory / "done", error), end; !error && entry != end; entry.increment(error))
+    {
+        std::ifstream inputStream(entry->path());
+        std::string worker;
+        int64_t claimTime, completionTime;
+        if (!(inputStream >> worker >> claimTime >> completionTime))
+            continue;
+        firstClaim = doneScenes == 0 ? claimTime : std::min(firstClaim, claimTime);
+        lastCompletion = std::max(lastCompletion, completionTime);
+        if (std::find(workers.begin(), workers.end(), worker) == workers.end())
+            workers.push_back(worker);
+        doneScenes++;
+    }
+
+    outputStream << "Work queue " << QueueDirectory << " : " << doneScenes << "/" << NumberOfScenes << " scenes done by " << workers.size() << " workers" << std::endl;
+    int64_t elapsed = GetTime() - StartTime;
+    if (elapsed > 0)
+        outputStream << "  this worker : " << CompletedScenes << " scenes, " << 3600.0 * CompletedScenes / elapsed << " scenes/hour" << std::endl;
+    if (lastCompletion > firstClaim)
+        outputStream << "  all workers : " << 3600.0 * doneScenes / (lastCompletion - firstClaim) << " scenes/hour" << std::endl;
+}
+
+bool WorkQueue::WriteLease(int sceneIndex)
+{
+    std::ostringstream lease;
+    lease << WorkerId << " " << GetTime() + (int64_t)LeaseDuration << std::endl;
+    return WriteFileAtomically(fs::path(QueueDirectory) / "leases" / std::to_string(sceneIndex) / "lease", lease.str(), WorkerId);
+}
+
+bool WorkQueue::ReadLease(int sceneIndex, std::string& owner, bool& expired)
+{
+    fs::path leasePath = fs::path(QueueDirectory) / "leases" / std::to_string(sceneIndex);
+    std::error_code error;
+    if (!fs::exists(leasePath, error))
+        return false;
+
+    int64_t expiry;
+    std::ifstream inputStream(leasePath / "lease");
+    if (!(inputStream >> owner >> expiry))
+    {
+        // The owner died between the claim and the first lease write, or is about to write it : give it a lease duration
+        owner = "";
+        fs::file_time_type claimTime = fs::last_write_time(leasePath, error);
+        expired = !error && fs::file_time_type::clock::now() - claimTime > std::chrono::seconds((int64_t)LeaseDuration);
+        return true;
+    }
+    expired = GetTime() > expiry;
+    return true;
+}
+
+bool WorkQueue::TakeOverLease(int sceneIndex, const std::string& previousOwner)
+{
+    // Only one of the workers trying to rename the expired lease succeeds, the others no longer find it
+    fs::path directory(QueueDirectory);
+    fs::path leasePath = directory / "leases" / std::to_string(sceneIndex);
+    fs::path expiredPath = directory / "leases" / (std::to_string(sceneIndex) + ".expired." + WorkerId);
+    std::error_code error;
+    fs::rename(leasePath, expiredPath, error);
+    if (error)
+        return false;
+
+    Log::Out() << "Taking over the expired lease of scene " << sceneIndex << std::endl;
+    fs::remove_all(expiredPath, error);
+    if (!previousOwner.empty())
+        fs::remove_all(directory / "staging" / (std::to_string(sceneIndex) + "." + previousOwner), error);
+    return true;
+}
+
+void WorkQueue::StartRenewing(int sceneIndex)
+{
+    StopRenewing();
+    RenewedScene = sceneIndex;
+    RenewThread = std::thread([this]()
+    {
+        std::unique_lock<std::mutex> lock(RenewMutex);
+        std::chrono::milliseconds period((int64_t)(1000.0 * LeaseDuration / 3.0));
+        while (RenewedScene >= 0)
+        {
+            if (RenewCondition.wait_for(lock, period, [this]() { return RenewedScene < 0; }))
+                break;
+            // A worker stalled for longer than the lease must not overwrite the lease of the worker which took over
+            std::string owner;
+            bool expired;
+            if (ReadLease(RenewedScene, owner, expired) && owner == WorkerId)
+                WriteLease(RenewedScene);
+        }
+    });
+}
+
+void WorkQueue::StopRenewing()
+{
+    {
+        std::lock_guard<std::mutex> lock(RenewMutex);
+        RenewedScene = -1;
+    }
+    RenewCondition.notify_all();
+    if (RenewThread.joinable())
+        RenewThread.join();
+}
@@ -0,0 +1,124 @@
+#pragma once
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <ostream>
+#include <cstdint>
+
+/// <summary>
+/// Queue of scenes to generate, shared through a directory between any number of generator processes on any number of nodes.
+/// The directory holds :
+///  - manifest.txt : number of scenes and base seed of the dataset
+///  - leases/[scene] : claim of a scene by a worker, created atomically and renewed while the scene is generated
+///  - staging/[scene].[worker] : outputs of a scene being generated
+///  - checkpoints/[scene] : settled large objects of a scene being generated, removed once the scene is done
+///  - outputs/ : outputs of the completed scenes, moved there by atomic renames
+///  - done/[scene] : completion marker, written once the outputs are in place
+/// A crashed worker stops renewing its lease, which expires and lets another worker generate the scene again from the same seed.
+/// </summary>
+class WorkQueue
+{
+public:
+	/// <summary>
+	/// Build a queue over a shared directory, nothing is read nor written before Open
+	/// </summary>
+	/// <param name="queueDirectory">Directory shared between the workers</param>
+	/// <param name="leaseDuration">Time (s) without renewal after which a claim is considered abandoned</param>
+	WorkQueue(std::string queueDirectory, double leaseDuration = 600.0);
+	~WorkQueue();
+	/// <summary>
+	/// Read the manifest of the queue, or create it if this worker is the first one
+	/// </summary>
+	/// <param name="numberOfScenes">Number of scenes of the dataset, only used if the manifest is created</param>
+	/// <param name="baseSeed">Seed from which every scene seed is derived, only used if the manifest is created</param>
+	/// <returns>False if the manifest could not be read nor created</returns>
+	bool Open(int numberOfScenes, unsigned int baseSeed);
+	/// <summary>
+	/// Claim a scene which is neither done nor claimed by a living worker. The lease is renewed in background until Complete or Release.
+	/// If the only remaining scenes are claimed by other workers, wait for them to be completed or for their lease to expire.
+	/// </summary>
+	/// <param name="sceneIndex">The claimed scene</param>
+	/// <returns>False once every scene is done</returns>
+	bool ClaimNext(int& sceneIndex);
+	/// <summary>
+	/// Seed of a scene, the same for every worker
+	/// </summary>
+	unsigned int GetSceneSeed(int sceneIndex);
+	/// <summary>
+	/// Directory where the outputs of the claimed scene should be written
+	/// </summary>
+	std::string GetStagingDirectory(int sceneIndex);
+	/// <summary>
+	/// Path of the checkpoint of the claimed scene, shared between the workers so that it survives a lease expiry
+	/// </summary>
+	std::string GetCheckpointPath(int sceneIndex);
+	/// <summary>
+	/// Move every file of the staging directory to the outputs, mark the scene as done, remove its checkpoint and release its lease
+	/// </summary>
+	/// <returns>False if the lease was lost (the scene is then left to the worker which took it over)</returns>
+	bool Complete(int sceneIndex);
+	/// <summary>
+	/// Give up a claimed scene, which can be claimed again immediately
+	/// </summary>
+	void Release(int sceneIndex);
+	/// <summary>
+	/// Write the progress of the dataset and the scenes/hour of this worker and of all the workers together
+	/// </summary>
+	void PrintReport(std::ostream& outputStream);
+
+public:
+	/// <summary>
+	/// Unique name of this worker (host name and random suffix)
+	/// </summary>
+	std::string WorkerId;
+	/// <summary>
+	/// Number of scenes of the dataset, read from the manifest
+	/// </summary>
+	int NumberOfScenes;
+	/// <summary>
+	/// Seed from which every scene seed is derived, read from the manifest
+	/// </summary>
+	unsigned int BaseSeed;
+	/// <summary>
+	/// Time (s) without renewal after which a claim is considered abandoned
+	/// </summary>
+	double LeaseDuration;
+
+private:
+	/// <summary>
+	/// Single pass of ClaimNext
+	/// </summary>
+	/// <param name="remainingScenes">False if every scene is done</param>
+	bool TryClaim(int& sceneIndex, bool& remainingScenes);
+	/// <summary>
+	/// Write the lease file of a scene, with an expiry time of now + LeaseDuration
+	/// </summary>
+	bool WriteLease(int sceneIndex);
+	/// <summary>
+	/// Read the owner of a lease, and whether it has expired
+	/// </summary>
+	/// <returns>False if the scene has no lease</returns>
+	bool ReadLease(int sceneIndex, std::string& owner, bool& expired);
+	/// <summary>
+	/// Try to take over an expired lease, only one worker can succeed
+	/// </summary>
+	bool TakeOverLease(int sceneIndex, const std::string& previousOwner);
+	void StartRenewing(int sceneIndex);
+	void StopRenewing();
+
+	std::string QueueDirectory;
+	/// <summary>
+	/// Scene whose lease is renewed by RenewThread, -1 if none
+	/// </summary>
+	int RenewedScene;
+	std::thread RenewThread;
+	std::mutex RenewMutex;
+	std::condition_variable RenewCondition;
+	/// <summary>
+	/// Claim time of the current scene, and totals of this worker
+	/// </summary>
+	int64_t ClaimTime;
+	int64_t StartTime;
+	int CompletedScenes;
+};
@@ -0,0 +1,304 @@
+#include "SceneGeneratorApi.h"
+#include <string>
+#include <thread>
+#include <algorithm>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include "SceneGeneration.h"
+#include "Log.h"
+
+
+struct sg_library
+{
+    sg_library(const char* layoutsRoot, const char* layoutsDescription, const char* layoutsProbability,
+        const char* objectsRoot, const char* objectsDescription, const char* largeObjectsProbability, const char* smallObjectsProbability) :
+        ScenesLibrary(layoutsRoot, layoutsDescription, layoutsProbability),
+        Library(objectsRoot, objectsDescription, largeObjectsProbability, smallObjectsProbability)
+    {
+    }
+
+    ObjectLibrary ScenesLibrary;
+    ObjectLibrary Library;
+    PointCloudProcessor Processor;
+    PhysicsTelemetry Telemetry;
+    /// <summary>
+    /// Settled large objects of the last seed, shared by its variants
+    /// </summary>
+    SceneCheckpoint Checkpoint;
+    bool HasCheckpoint = false;
+    unsigned int CheckpointSeed = 0;
+};
+
+struct sg_scene
+{
+    GeneratedVariant Variant;
+    /// <summary>
+    /// Label of each object of the variant
+    /// </summary>
+    std::vector<int> Labels;
+};
+
+
+namespace
+{
+    thread_local std::string LastError;
+
+    void SetLastError(const std::string& message)
+    {
+        LastError = message;
+    }
+
+    // The process-wide state is only written once, before any library can use it
+    std::mutex InitializationMutex;
+    bool Initialized = false;
+
+    void ApplyConfig(const sg_config& config)
+    {
+        Log::Enabled = config.verbose != 0;
+        // Only the physics is needed, no visualisation asset is built
+        Scene::Headless = true;
+        Scene::NumberOfThreads = config.number_of_threads > 0 ? config.number_of_threads : std::max(1, (int)std::thread::hardware_concurrency());
+        Initialized = true;
+    }
+}
+
+
+int sg_get_api_version(void)
+{
+    return SG_API_VERSION;
+}
+
+const char* sg_get_last_error(void)
+{
+    return LastError.c_str();
+}
+
+void sg_default_config(sg_config* config)
+{
+    if (!config)
+        return;
+    config->struct_size = sizeof(sg_config);
+    config->verbose = 0;
+    config->number_of_threads = 0;
+}
+
+int sg_initialize(const sg_config* config)
+{
+    if (!config || config->struct_size != sizeof(sg_config))
+    {
+        SetLastError("sg_initialize : the config must be initialized by sg_default_config");
+        return 0;
+    }
+    std::lock_guard<std::mutex> lock(InitializationMutex);
+    if (Initialized)
+    {
+        SetLastError("sg_initialize : already initialized, it must be called once before the first sg_open_library");
+        return 0;
+    }
+    ApplyConfig(*config);
+    SetLastError("");
+    return 1;
+}
+
+sg_library* sg_open_library(const char* layoutsRoot, const char* layoutsDescription, const char* layoutsProbability,
+    const char* objectsRoot, const char* objectsDescription, const char* largeObjectsProbability, const char* smallObjectsProbability)
+{
+    if (!layoutsRoot || !layoutsDescription || !layoutsProbability || !objectsRoot || !objectsDescription || !largeObjectsProbability || !smallObjectsProbability)
+    {
+        SetLastError("sg_open_library : every path is required");
+        return nullptr;
+    }
+    try
+    {
+        {
+            std::lock_guard<std::mutex> lock(InitializationMutex);
+            if (!Initialized)
+            {
+                sg_config config;
+                sg_default_config(&config);
+                ApplyConfig(config);
+            }
+        }
+        sg_library* library = new sg_library(layoutsRoot, layoutsDescription, layoutsProbability, objectsRoot, objectsDescription, largeObjectsProbability, smallObjectsProbability);
+        if (library->ScenesLibrary.LargeObjects.empty() || library->Library.LargeObjects.empty() || library->Library.SmallObjects.empty())
+        {
+            SetLastError("sg_open_library : a library description is empty or could not be read");
+            delete library;
+            return nullptr;
+        }
+        SetLastError("");
+        return library;
+    }
+    catch (const std::exception& exception)
+    {
+        SetLastError(std::string("sg_open_library : ") + exception.what());
+        return nullptr;
+    }
+}
+
+void sg_close_library(sg_library* library)
+{
+    delete library;
+}
+
+const char* sg_get_label_wnids(const sg_library* library, int label)
+{
+    if (!library)
+        return nullptr;
+    if (label == 0)
+        return "layout";
+    for (auto& wnidsLabel : library->Library.Labels)
+    {
+        if (wnidsLabel.second == label)
+            return wnidsLabel.first.c_str();
+    }
+    return nullptr;
+}
+
+void sg_default_parameters(sg_parameters* parameters)
+{
+    if (!parameters)
+        return;
+    PointCloudProcessor defaults;
+    parameters->struct_size = sizeof(sg_parameters);
+    parameters->variant = 0;
+    parameters->generate_point_cloud = 1;
+    parameters->sampling_density = defaults.SamplingDensity;
+    parameters->voxel_size = defaults.VoxelSize;
+    parameters->normal_radius = defaults.NormalRadius;
+    parameters->noise_base = defaults.NoiseBase;
+    parameters->noise_per_square_meter = defaults.NoisePerSquareMeter;
+    parameters->dropout_base = defaults.DropoutBase;
+    parameters->dropout_per_meter = defaults.DropoutPerMeter;
+    parameters->dropout_grazing = defaults.DropoutGrazing;
+    parameters->range_resolution = defaults.RangeResolution;
+    parameters->number_of_threads = 0;
+}
+
+sg_scene* sg_generate_scene(sg_library* library, unsigned int seed, const sg_parameters* parameters)
+{
+    if (!library || !parameters)
+    {
+        SetLastError("sg_generate_scene : library and parameters are required");
+        return nullptr;
+    }
+    if (parameters->struct_size != sizeof(sg_parameters))
+    {
+        SetLastError("sg_generate_scene : the parameters must be initialized by sg_default_parameters of the same API version");
+        return nullptr;
+    }
+    if (parameters->variant < 0)
+    {
+        SetLastError("sg_generate_scene : the variant must be positive");
+        return nullptr;
+    }
+    try
+    {
+        if (!library->HasCheckpoint || library->CheckpointSeed != seed)
+        {
+            library->HasCheckpoint = false;
+            settle_scene(library->ScenesLibrary, library->Library, seed, library->Checkpoint, library->Telemetry);
+            library->HasCheckpoint = true;
+            library->CheckpointSeed = seed;
+        }
+
+        PointCloudProcessor& processor = library->Processor;
+        processor.SamplingDensity = parameters->sampling_density;
+        processor.VoxelSize = parameters->voxel_size;
+        processor.NormalRadius = parameters->normal_radius;
+        processor.NoiseBase = parameters->noise_base;
+        processor.NoisePerSquareMeter = parameters->noise_per_square_meter;
+        processor.DropoutBase = parameters->dropout_base;
+        processor.DropoutPerMeter = parameters->dropout_per_meter;
+        processor.DropoutGrazing = parameters->dropout_grazing;
+        processor.RangeResolution = parameters->range_resolution;
+        processor.NumberOfThreads = parameters->number_of_threads > 0 ? parameters->number_of_threads : std::max(1, (int)std::thread::hardware_concurrency());
+
+        std::unique_ptr<sg_scene> scene(new sg_scene);
+        // Same variant seeds as the executable, so that both produce the same scenes
+        scene->Variant = generate_variant(library->Checkpoint, library->Library, seed + 1 + parameters->variant,
+            parameters->generate_point_cloud ? &processor : nullptr, library->Telemetry);
+        for (auto& object : scene->Variant.Objects)
+            scene->Labels.push_back(library->Library.GetLabel(object.BaseObject.Wnids));
+        SetLastError("");
+        return scene.release();
+    }
+    catch (const std::exception& exception)
+    {
+        SetLastError(std::string("sg_generate_scene : ") + exception.what());
+        return nullptr;
+    }
+}
+
+void sg_free_scene(sg_scene* scene)
+{
+    delete scene;
+}
+
+size_t sg_get_object_count(const sg_scene* scene)
+{
+    return scene ? scene->Variant.Objects.size() : 0;
+}
+
+size_t sg_get_point_count(const sg_scene* scene)
+{
+    return scene ? scene->Variant.Cloud.Size() : 0;
+}
+
+const char* sg_get_layout_file(const sg_scene* scene)
+{
+    return scene ? scene->Variant.LayoutFile.c_str() : nullptr;
+}
+
+const char* sg_get_object_file(const sg_scene* scene, size_t index)
+{
+    if (!scene || index >= scene->Variant.Objects.size())
+        return nullptr;
+    return scene->Variant.Objects[index].BaseObject.AssociatedFile.c_str();
+}
+
+size_t sg_get_poses(const sg_scene* scene, sg_pose* poses, size_t capacity)
+{
+    if (!scene || !poses)
+        return 0;
+    size_t count = std::min(capacity, scene->Variant.Objects.size());
+    for (size_t i = 0; i < count; i++)
+    {
+        const ObjectPose& object = scene->Variant.Objects[i];
+        for (int j = 0; j < 9; j++)
+            poses[i].rotation[j] = object.Rotation(j);
+        for (int j = 0; j < 3; j++)
+            poses[i].position[j] = object.Position[j];
+        poses[i].scale = object.Scale;
+        poses[i].label = scene->Labels[i];
+    }
+    return count;
+}
+
+size_t sg_get_points(const sg_scene* scene, float* positions, float* normals, int* labels, size_t capacity)
+{
+    if (!scene)
+        return 0;
+    const PointCloud& cloud = scene->Variant.Cloud;
+    size_t count = std::min(capacity, cloud.Size());
+    bool hasNormals = cloud.NX.size() == cloud.Size();
+    for (size_t i = 0; i < count; i++)
+    {
+        if (positions)
+        {
+            positions[3 * i] = cloud.X[i];
+            positions[3 * i + 1] = cloud.Y[i];
+            positions[3 * i + 2] = cloud.Z[i];
+        }
+        if (normals)
+        {
+            normals[3 * i] = hasNormals ? cloud.NX[i] : 0.0f;
+            normals[3 * i + 1] = hasNormals ? cloud.NY[i] : 0.0f;
+            normals[3 * i + 2] = hasNormals ? cloud.NZ[i] : 0.0f;
+        }
+        if (labels)
+            labels[i] = cloud.Labels[i];
+    }
+    return count;
+}
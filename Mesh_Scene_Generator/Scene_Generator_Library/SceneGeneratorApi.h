@@ -0,0 +1,121 @@
+#pragma once
+#include <stddef.h>
+
+/*
+ * C interface of the scene generator, to generate scenes in process (e.g. from a training data loader) instead of reading output files.
+ * The results are copied into buffers given by the caller. Every function is safe to call with a NULL handle.
+ * A library handle must not be used by two threads at once, distinct handles can generate scenes in parallel.
+ *
+ * Some state is process-wide and shared by every handle : the logging switch, the headless mode, the threads used to prepare the objects,
+ * and the caches of welded meshes and layout proxies (which are thread safe). It is set once by sg_initialize, before the first sg_open_library.
+ */
+
+#ifdef _WIN32
+#ifdef SCENE_GENERATOR_EXPORTS
+#define SCENE_GENERATOR_API __declspec(dllexport)
+#else
+#define SCENE_GENERATOR_API __declspec(dllimport)
+#endif
+#else
+#define SCENE_GENERATOR_API __attribute__((visibility("default")))
+#endif
+
+#define SG_API_VERSION 3
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Layouts and object libraries, with the state reused between the scenes */
+typedef struct sg_library sg_library;
+/* Generated scene */
+typedef struct sg_scene sg_scene;
+
+/* Process-wide settings, to be initialized by sg_default_config */
+typedef struct sg_config
+{
+    /* sizeof(sg_config) as known by the caller, set by sg_default_config */
+    size_t struct_size;
+    /* If not 0, the progress of the generation is written to the standard output. 0 by default. */
+    int verbose;
+    /* Threads loading the meshes and building the collision models of the objects, every available core if 0 */
+    int number_of_threads;
+} sg_config;
+
+/* Generation settings, to be initialized by sg_default_parameters */
+typedef struct sg_parameters
+{
+    /* sizeof(sg_parameters) as known by the caller, set by sg_default_parameters */
+    size_t struct_size;
+    /* Small objects variant, the large objects of a seed are shared by its variants (seed + 1 + variant is used for the small objects) */
+    int variant;
+    /* If 0, no point cloud is generated */
+    int generate_point_cloud;
+    /* Point cloud settings, see PointCloudProcessor */
+    double sampling_density;
+    float voxel_size;
+    float normal_radius;
+    float noise_base;
+    float noise_per_square_meter;
+    float dropout_base;
+    float dropout_per_meter;
+    float dropout_grazing;
+    float range_resolution;
+    /* Threads of the point cloud processing, every available core if 0 */
+    int number_of_threads;
+} sg_parameters;
+
+/* Pose of a generated object */
+typedef struct sg_pose
+{
+    /* Rotation matrix in the world frame, row major */
+    double rotation[9];
+    /* Position of the object reference frame (m) */
+    double position[3];
+    /* Scale of the object, compared to its mesh file */
+    double scale;
+    /* Label of the object, as used for the points (see sg_get_label_wnids), -1 if its wnids are not in the library */
+    int label;
+} sg_pose;
+
+/* SG_API_VERSION of the loaded library */
+SCENE_GENERATOR_API int sg_get_api_version(void);
+/* Description of the last error of the calling thread, empty if none */
+SCENE_GENERATOR_API const char* sg_get_last_error(void);
+
+SCENE_GENERATOR_API void sg_default_config(sg_config* config);
+/*
+ * Apply the process-wide settings, 0 on error. Must be called before the first sg_open_library, and at most once.
+ * Optional : the first sg_open_library applies the default settings otherwise.
+ */
+SCENE_GENERATOR_API int sg_initialize(const sg_config* config);
+
+/* Read the layout and object libraries (same files as the executable), NULL on error */
+SCENE_GENERATOR_API sg_library* sg_open_library(const char* layoutsRoot, const char* layoutsDescription, const char* layoutsProbability,
+    const char* objectsRoot, const char* objectsDescription, const char* largeObjectsProbability, const char* smallObjectsProbability);
+SCENE_GENERATOR_API void sg_close_library(sg_library* library);
+/* Wnids field of the objects with a given label, "layout" for 0, NULL if no object has this label. Valid until the library is closed. */
+SCENE_GENERATOR_API const char* sg_get_label_wnids(const sg_library* library, int label);
+
+SCENE_GENERATOR_API void sg_default_parameters(sg_parameters* parameters);
+/* Generate a scene from a seed, NULL on error. The same seed and parameters always give the same scene. */
+SCENE_GENERATOR_API sg_scene* sg_generate_scene(sg_library* library, unsigned int seed, const sg_parameters* parameters);
+SCENE_GENERATOR_API void sg_free_scene(sg_scene* scene);
+
+SCENE_GENERATOR_API size_t sg_get_object_count(const sg_scene* scene);
+SCENE_GENERATOR_API size_t sg_get_point_count(const sg_scene* scene);
+/* Mesh files, valid until the scene is freed */
+SCENE_GENERATOR_API const char* sg_get_layout_file(const sg_scene* scene);
+SCENE_GENERATOR_API const char* sg_get_object_file(const sg_scene* scene, size_t index);
+/* Copy at most capacity poses, returns the number of copied poses */
+SCENE_GENERATOR_API size_t sg_get_poses(const sg_scene* scene, sg_pose* poses, size_t capacity);
+/*
+ * Copy at most capacity points, returns the number of copied points.
+ * positions and normals receive 3 floats per point (x y z), labels one int per point, any of them can be NULL.
+ * Normals are 0 if the point cloud settings do not estimate them.
+ */
+SCENE_GENERATOR_API size_t sg_get_points(const sg_scene* scene, float* positions, float* normals, int* labels, size_t capacity);
+
+#ifdef __cplusplus
+}
+#endif